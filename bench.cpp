@@ -0,0 +1,646 @@
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  benchmark of the whole lottie to WebP conversion, phase by phase
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <webp/encode.h>
+#include <webp/mux.h>
+#include "lib/rlottie/inc/rlottie.h"
+#include "zlib.h"
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+// Pipeline phases, in the order of kTimeFields.
+enum Phase {
+    kGunzip, kParse, kBake, kUpdate, kRasterize, kBlend, kEncode, kAssemble,
+    kPhaseCount
+};
+
+// Hardware events counted with -perf.
+enum Event { kCycles, kInstructions, kLlcMisses, kBranchMisses, kEventCount };
+
+const char *const kEventKeys[kEventCount] = {
+    "cycles", "instructions", "llc_misses", "branch_misses",
+};
+
+struct Counts {
+    uint64_t events[kEventCount] = {};
+
+    Counts &operator+=(const Counts &other) {
+        for (int i = 0; i < kEventCount; ++i) events[i] += other.events[i];
+        return *this;
+    }
+};
+
+struct Result {
+    std::string name;
+    int frames = 0;
+    double gunzip_ms = 0;
+    double parse_ms = 0;
+    double bake_ms = 0;
+    double update_ms = 0;
+    double rasterize_ms = 0;
+    double blend_ms = 0;
+    double encode_ms = 0;
+    double assemble_ms = 0;
+    size_t bytes = 0;
+    long peak_rss_kb = 0;
+    Counts counts[kPhaseCount];
+
+    double total_ms() const {
+        return gunzip_ms + parse_ms + bake_ms + update_ms + rasterize_ms +
+               blend_ms + encode_ms + assemble_ms;
+    }
+    double fps() const {
+        const double ms = update_ms + rasterize_ms + blend_ms + encode_ms;
+        return ms > 0 ? 1000. * frames / ms : 0.;
+    }
+};
+
+// Phase timings, as reported and compared with the baseline.
+const struct {
+    const char *key;
+    double Result::*time;
+} kTimeFields[] = {
+    {"gunzip_ms", &Result::gunzip_ms},
+    {"parse_ms", &Result::parse_ms},
+    {"bake_ms", &Result::bake_ms},
+    {"update_ms", &Result::update_ms},
+    {"rasterize_ms", &Result::rasterize_ms},
+    {"blend_ms", &Result::blend_ms},
+    {"encode_ms", &Result::encode_ms},
+    {"assemble_ms", &Result::assemble_ms},
+};
+static_assert(sizeof(kTimeFields) / sizeof(kTimeFields[0]) == kPhaseCount,
+              "a phase without timing");
+
+// "gunzip" for "gunzip_ms".
+std::string PhaseName(int phase) {
+    const std::string key = kTimeFields[phase].key;
+    return key.substr(0, key.size() - strlen("_ms"));
+}
+
+// Phases shorter than this are too noisy to be flagged.
+const double kMinFlaggedMs = 5.;
+
+double Elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start).count();
+}
+
+// Counts hardware events of the whole process with perf_event_open(2). The
+// counters are inherited by the threads started afterwards, so the render
+// threads of rlottie and the encoder threads are counted too. Sample() adds
+// the events since the previous sample to a phase, which gets the same
+// boundaries as its timing.
+class PerfCounters {
+public:
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int fd : mFds) {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+
+    // Opens the counters of the events the CPU and the kernel allow, or
+    // prints why none could be opened.
+    bool Open() {
+#if defined(__linux__)
+        static const uint64_t configs[kEventCount] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        int error = 0;
+        for (int i = 0; i < kEventCount; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.inherit = 1;
+            // perf_event_paranoid 2, the default, allows user space only.
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            mFds[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                                  PERF_FLAG_FD_CLOEXEC));
+            if (mFds[i] < 0) {
+                error = errno;
+            } else {
+                mEnabled = true;
+            }
+        }
+        if (!mEnabled) {
+            const char *hint = "";
+            if (error == EACCES || error == EPERM) {
+                hint = ", see /proc/sys/kernel/perf_event_paranoid";
+            } else if (error == ENOENT) {
+                hint = ", the CPU or VM has no PMU";
+            }
+            fprintf(stderr, "Warning! No hardware counters: %s%s\n",
+                    strerror(error), hint);
+            return false;
+        }
+        for (int i = 0; i < kEventCount; ++i) {
+            if (mFds[i] < 0) {
+                fprintf(stderr, "Warning! No %s counter.\n", kEventKeys[i]);
+            }
+        }
+        Read(mLast);
+        return true;
+#else
+        fprintf(stderr, "Warning! Hardware counters need Linux.\n");
+        return false;
+#endif
+    }
+
+    bool Has(int event) const { return mFds[event] >= 0; }
+
+    // Adds the events since the previous sample to 'counts', which may be
+    // null to skip them.
+    void Sample(Counts *counts) {
+        if (!mEnabled) return;
+        uint64_t now[kEventCount];
+        Read(now);
+        for (int i = 0; i < kEventCount; ++i) {
+            if (counts != nullptr && now[i] > mLast[i]) {
+                counts->events[i] += now[i] - mLast[i];
+            }
+            mLast[i] = now[i];
+        }
+    }
+
+private:
+    // Events so far, scaled up for the time a counter was multiplexed out.
+    void Read(uint64_t values[kEventCount]) const {
+        for (int i = 0; i < kEventCount; ++i) {
+            values[i] = 0;
+#if defined(__linux__)
+            uint64_t data[3];  // value, time enabled, time running
+            if (mFds[i] < 0 ||
+                read(mFds[i], data, sizeof(data)) != sizeof(data) ||
+                data[2] == 0) {
+                continue;
+            }
+            values[i] = uint64_t(double(data[0]) * data[1] / data[2]);
+#endif
+        }
+    }
+
+    int mFds[kEventCount] = {-1, -1, -1, -1};
+    uint64_t mLast[kEventCount] = {};
+    bool mEnabled = false;
+};
+
+// The counters of -perf, null without it.
+PerfCounters *g_perf = nullptr;
+// The result of the file being converted, for OnRenderPhase().
+Result *g_result = nullptr;
+
+// The events before a phase belong to none.
+void BeginPhase() {
+    if (g_perf != nullptr) g_perf->Sample(nullptr);
+}
+
+void EndPhase(Result *result, Phase phase) {
+    if (g_perf != nullptr) g_perf->Sample(&result->counts[phase]);
+}
+
+void OnRenderPhase(rlottie::RenderPhase phase, bool end) {
+    static_assert(kUpdate + int(rlottie::RenderPhase::Blend) == kBlend,
+                  "render phases out of order");
+    if (end) {
+        EndPhase(g_result, Phase(kUpdate + int(phase)));
+    } else {
+        BeginPhase();
+    }
+}
+
+bool EndsWith(const std::string &s, const char *suffix) {
+    const size_t n = strlen(suffix);
+    return s.size() > n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Appends the .json and .tgs files of 'path' to 'files'; 'path' may also be
+// one such file.
+void AddInputs(const std::string &path, std::vector<std::string> *files) {
+    DIR *const dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        files->push_back(path);
+        return;
+    }
+    std::vector<std::string> names;
+    while (const struct dirent *entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (EndsWith(name, ".json") || EndsWith(name, ".tgs")) {
+            names.push_back(path + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    files->insert(files->end(), names.begin(), names.end());
+}
+
+bool ReadInput(const std::string &path, std::string *json, Result *result) {
+    BeginPhase();
+    const auto start = std::chrono::steady_clock::now();
+    gzFile file = gzopen(path.c_str(), "rb");  // Reads .json files as is.
+    if (file == nullptr) return false;
+    char buffer[16384];
+    int len;
+    while ((len = gzread(file, buffer, sizeof(buffer))) > 0) {
+        json->append(buffer, len);
+    }
+    const bool ok = (len == 0);
+    gzclose(file);
+    if (EndsWith(path, ".tgs")) {
+        result->gunzip_ms = Elapsed(start);
+        EndPhase(result, kGunzip);
+    }
+    return ok && !json->empty();
+}
+
+bool Convert(const std::string &path, int skip, int size,
+             const WebPConfig *config,
+             const WebPAnimEncoderOptions *enc_options, Result *result) {
+    std::string json;
+    result->name = path.substr(path.find_last_of('/') + 1);
+    if (!ReadInput(path, &json, result)) {
+        fprintf(stderr, "Error! Could not read '%s'\n", path.c_str());
+        return false;
+    }
+
+    BeginPhase();
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<rlottie::Animation> player =
+        rlottie::Animation::loadFromData(json, path, "", false);
+    result->parse_ms = Elapsed(start);
+    EndPhase(result, kParse);
+    if (player == nullptr) {
+        fprintf(stderr, "Error! Could not parse '%s'\n", path.c_str());
+        return false;
+    }
+    BeginPhase();
+    start = std::chrono::steady_clock::now();
+    player->bake(8 * 1024 * 1024);
+    result->bake_ms = Elapsed(start);
+    EndPhase(result, kBake);
+
+    const int total_frames = int(player->totalFrame());
+    const int duration = int(player->duration() * 1000);
+    const int frame_duration =
+        duration / std::max(total_frames / skip, 1);
+    std::unique_ptr<uint32_t[]> buffer(new uint32_t[size * size]);
+    WebPAnimEncoder *enc = WebPAnimEncoderNew(size, size, enc_options);
+    int timestamp = 0;
+    bool ok = (enc != nullptr);
+    g_result = result;
+    for (int i = 0; ok && i < total_frames; i += skip) {
+        rlottie::Surface surface(buffer.get(), size, size, size * 4);
+        player->renderSync(i, surface);
+
+        WebPPicture frame;
+        ok = WebPPictureInit(&frame);
+        frame.width = size;
+        frame.height = size;
+        frame.use_argb = 1;
+        frame.argb = buffer.get();
+        frame.argb_stride = size;
+        BeginPhase();
+        start = std::chrono::steady_clock::now();
+        ok = ok && WebPAnimEncoderAdd(enc, &frame, timestamp, config);
+        result->encode_ms += Elapsed(start);
+        EndPhase(result, kEncode);
+        timestamp += frame_duration;
+        ++result->frames;
+    }
+    const rlottie::RenderTimings timings = player->renderTimings();
+    result->update_ms = timings.updateMs;
+    result->rasterize_ms = timings.rasterizeMs;
+    result->blend_ms = timings.blendMs;
+
+    WebPData webp_data;
+    WebPDataInit(&webp_data);
+    BeginPhase();
+    start = std::chrono::steady_clock::now();
+    ok = ok && WebPAnimEncoderAdd(enc, nullptr, timestamp, nullptr);
+    ok = ok && WebPAnimEncoderAssemble(enc, &webp_data);
+    result->assemble_ms = Elapsed(start);
+    EndPhase(result, kAssemble);
+    result->bytes = webp_data.size;
+    if (!ok) {
+        fprintf(stderr, "Error! Could not encode '%s': %s\n", path.c_str(),
+                enc != nullptr ? WebPAnimEncoderGetError(enc) : "");
+    }
+    WebPDataClear(&webp_data);
+    WebPAnimEncoderDelete(enc);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        result->peak_rss_kb = usage.ru_maxrss;
+    }
+    return ok;
+}
+
+// Writes 'result' as a JSON object on one line, which is what ReadBaseline()
+// expects.
+void WriteResult(FILE *out, const Result &result, bool with_name) {
+    fprintf(out, "{");
+    if (with_name) fprintf(out, "\"name\": \"%s\", ", result.name.c_str());
+    fprintf(out, "\"frames\": %d", result.frames);
+    for (const auto &field : kTimeFields) {
+        fprintf(out, ", \"%s\": %.2f", field.key, result.*field.time);
+    }
+    fprintf(out, ", \"total_ms\": %.2f, \"fps\": %.2f, \"bytes\": %zu, "
+            "\"peak_rss_kb\": %ld", result.total_ms(), result.fps(),
+            result.bytes, result.peak_rss_kb);
+    if (g_perf != nullptr) {
+        fprintf(out, ", \"counters\": {");
+        for (int phase = 0; phase < kPhaseCount; ++phase) {
+            fprintf(out, "%s\"%s\": {", phase ? ", " : "",
+                    PhaseName(phase).c_str());
+            const char *separator = "";
+            for (int event = 0; event < kEventCount; ++event) {
+                if (!g_perf->Has(event)) continue;
+                fprintf(out, "%s\"%s\": %llu", separator, kEventKeys[event],
+                        static_cast<unsigned long long>(
+                            result.counts[phase].events[event]));
+                separator = ", ";
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "}");
+}
+
+// Formats 'n' per 'per' events, or "-" if either isn't counted.
+std::string Ratio(const Counts &counts, int n, int per, double scale) {
+    if (!g_perf->Has(n) || !g_perf->Has(per) || counts.events[per] == 0) {
+        return "-";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f",
+             scale * double(counts.events[n]) / double(counts.events[per]));
+    return buffer;
+}
+
+// Prints the events of each phase of 'total'. A low IPC with many LLC misses
+// per thousand instructions points to a phase bound by memory.
+void PrintCounters(const Result &total) {
+    fprintf(stderr, "%-10s %10s %6s %15s %18s\n", "phase", "Mcycles", "IPC",
+            "LLC miss/kinst", "branch miss/kinst");
+    for (int phase = 0; phase < kPhaseCount; ++phase) {
+        const Counts &counts = total.counts[phase];
+        fprintf(stderr, "%-10s %10.1f %6s %15s %18s\n",
+                PhaseName(phase).c_str(), counts.events[kCycles] / 1e6,
+                Ratio(counts, kInstructions, kCycles, 1.).c_str(),
+                Ratio(counts, kLlcMisses, kInstructions, 1000.).c_str(),
+                Ratio(counts, kBranchMisses, kInstructions, 1000.).c_str());
+    }
+}
+
+double GetNumber(const std::string &line, const char *key) {
+    const std::string pattern = std::string("\"") + key + "\": ";
+    const size_t pos = line.find(pattern);
+    if (pos == std::string::npos) return 0.;
+    return strtod(line.c_str() + pos + pattern.size(), nullptr);
+}
+
+// Reads the per-file results of a report written by this tool.
+bool ReadBaseline(const char *path, std::vector<Result> *results) {
+    FILE *const file = fopen(path, "r");
+    if (file == nullptr) return false;
+    char buffer[4096];
+    while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+        const std::string line = buffer;
+        const size_t pos = line.find("\"name\": \"");
+        if (pos == std::string::npos) continue;
+        const size_t start = pos + strlen("\"name\": \"");
+        Result result;
+        result.name = line.substr(start, line.find('"', start) - start);
+        result.frames = int(GetNumber(line, "frames"));
+        for (const auto &field : kTimeFields) {
+            result.*field.time = GetNumber(line, field.key);
+        }
+        result.bytes = size_t(GetNumber(line, "bytes"));
+        results->push_back(result);
+    }
+    fclose(file);
+    return true;
+}
+
+// Prints the phases of 'results' that got slower than in 'baseline' by more
+// than 'threshold' percent, and the outputs that got bigger. Returns the
+// number of regressions.
+int CompareWithBaseline(const std::vector<Result> &results,
+                        const std::vector<Result> &baseline,
+                        double threshold) {
+    int regressions = 0;
+    for (const Result &result : results) {
+        const auto old = std::find_if(
+            baseline.begin(), baseline.end(),
+            [&result](const Result &r) { return r.name == result.name; });
+        if (old == baseline.end()) continue;
+        for (const auto &field : kTimeFields) {
+            const double before = (*old).*field.time;
+            const double after = result.*field.time;
+            if (after >= kMinFlaggedMs &&
+                after > before * (1. + threshold / 100.)) {
+                fprintf(stderr, "REGRESSION %s %s: %.2f -> %.2f ms (%+.1f%%)\n",
+                        result.name.c_str(), field.key, before, after,
+                        before > 0 ? 100. * (after - before) / before : 100.);
+                ++regressions;
+            }
+        }
+        if (result.bytes > old->bytes) {
+            fprintf(stderr, "REGRESSION %s bytes: %zu -> %zu\n",
+                    result.name.c_str(), old->bytes, result.bytes);
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+void Help() {
+    printf("Usage:\n");
+    printf(" tgswebp_bench [options] [files or directories]\n");
+    printf("Converts each .json / .tgs file and reports the time spent in each\n"
+           "phase as JSON. Without inputs, the bundled lottie corpus is used.\n");
+    printf("Options:\n");
+    printf("  -h / -help ............. this help\n");
+    printf("  -o <file> .............. write the report to this file\n"
+           "                           (default: stdout)\n");
+    printf("  -baseline <file> ....... report phases slower than in this\n"
+           "                           earlier report, and bigger outputs;\n"
+           "                           exits with 1 if there are any\n");
+    printf("  -threshold <float> ..... slowdown in %% that is reported\n"
+           "                           (default: 10)\n");
+    printf("  -s <int> ............... render every n-th frame (default: 1)\n");
+    printf("  -size <int> ............ frame width and height (default: 512)\n");
+    printf("  -mixed ................. encode with mixed compression\n");
+    printf("  -q <float> ............. quality factor (0:small..100:big)\n");
+    printf("  -m <int> ............... compression method (0=fast, 6=slowest)\n");
+    printf("  -mt .................... use multi-threading if available\n");
+    printf("  -perf .................. also count the cycles, instructions,\n"
+           "                           LLC misses and branch misses of each\n"
+           "                           phase, with Linux perf_event_open\n");
+    printf("\n");
+}
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+
+int main(int argc, const char *argv[]) {
+    const char *out_file = nullptr, *baseline_file = nullptr;
+    double threshold = 10.;
+    int skip = 1, size = 512;
+    bool perf = false;
+    std::vector<std::string> files;
+    WebPAnimEncoderOptions enc_options;
+    WebPConfig config;
+
+    if (!WebPConfigInit(&config) || !WebPAnimEncoderOptionsInit(&enc_options)) {
+        fprintf(stderr, "Error! Version mismatch!\n");
+        return 1;
+    }
+    for (int c = 1; c < argc; ++c) {
+        const bool has_value = (c < argc - 1);
+        if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
+            Help();
+            return 0;
+        } else if (!strcmp(argv[c], "-o") && has_value) {
+            out_file = argv[++c];
+        } else if (!strcmp(argv[c], "-baseline") && has_value) {
+            baseline_file = argv[++c];
+        } else if (!strcmp(argv[c], "-threshold") && has_value) {
+            threshold = atof(argv[++c]);
+        } else if (!strcmp(argv[c], "-s") && has_value) {
+            skip = std::max(atoi(argv[++c]), 1);
+        } else if (!strcmp(argv[c], "-size") && has_value) {
+            size = std::max(atoi(argv[++c]), 1);
+        } else if (!strcmp(argv[c], "-mixed")) {
+            enc_options.allow_mixed = 1;
+        } else if (!strcmp(argv[c], "-q") && has_value) {
+            config.quality = float(atof(argv[++c]));
+        } else if (!strcmp(argv[c], "-m") && has_value) {
+            config.method = atoi(argv[++c]);
+        } else if (!strcmp(argv[c], "-mt")) {
+            ++config.thread_level;
+        } else if (!strcmp(argv[c], "-perf")) {
+            perf = true;
+        } else if (argv[c][0] == '-') {
+            fprintf(stderr, "Error! Unknown option '%s'\n", argv[c]);
+            Help();
+            return 1;
+        } else {
+            AddInputs(argv[c], &files);
+        }
+    }
+    if (files.empty()) {
+        AddInputs(TGSWEBP_SOURCE_DIR "/lib/rlottie/example/resource", &files);
+        AddInputs(TGSWEBP_SOURCE_DIR "/examples/1762", &files);
+    }
+    // Same encoder settings as tgswebp.
+    config.lossless = !enc_options.allow_mixed;
+    config.sns_strength = 90;
+    config.filter_sharpness = 6;
+    config.alpha_quality = 5;
+    if (!WebPValidateConfig(&config)) {
+        fprintf(stderr, "Error! Invalid configuration.\n");
+        return 1;
+    }
+
+    // Opened before rlottie and the encoder start their threads, which
+    // inherit the counters.
+    PerfCounters counters;
+    if (perf && counters.Open()) {
+        g_perf = &counters;
+        rlottie::configureRenderPhaseHook(OnRenderPhase);
+    }
+
+    std::vector<Result> results;
+    Result total;
+    total.name = "total";
+    bool ok = true;
+    for (const std::string &path : files) {
+        Result result;
+        if (!Convert(path, skip, size, &config, &enc_options, &result)) {
+            ok = false;
+            continue;
+        }
+        fprintf(stderr, "%-40s %5d frames %10.1f ms\n", result.name.c_str(),
+                result.frames, result.total_ms());
+        total.frames += result.frames;
+        for (const auto &field : kTimeFields) {
+            total.*field.time += result.*field.time;
+        }
+        for (int phase = 0; phase < kPhaseCount; ++phase) {
+            total.counts[phase] += result.counts[phase];
+        }
+        total.bytes += result.bytes;
+        total.peak_rss_kb = result.peak_rss_kb;
+        results.push_back(result);
+    }
+
+    FILE *const out = (out_file != nullptr) ? fopen(out_file, "w") : stdout;
+    if (out == nullptr) {
+        fprintf(stderr, "Error! Could not open '%s'\n", out_file);
+        return 1;
+    }
+    fprintf(out, "{\n  \"files\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        fprintf(out, "    ");
+        WriteResult(out, results[i], true);
+        fprintf(out, "%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"total\": ");
+    WriteResult(out, total, false);
+    fprintf(out, "\n}\n");
+    if (out != stdout) fclose(out);
+    if (g_perf != nullptr) PrintCounters(total);
+
+    if (baseline_file != nullptr) {
+        std::vector<Result> baseline;
+        if (!ReadBaseline(baseline_file, &baseline)) {
+            fprintf(stderr, "Error! Could not read '%s'\n", baseline_file);
+            return 1;
+        }
+        const int regressions =
+            CompareWithBaseline(results, baseline, threshold);
+        fprintf(stderr, "%d regression(s) against %s\n", regressions,
+                baseline_file);
+        if (regressions > 0) ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,646 @@
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  golden-output regression test of the lottie to WebP conversion
+//
+//  Every frame of every input is rendered and hashed, along with the render
+//  tree of each top level layer, and the frames are encoded to WebP as
+//  tgswebp does. The hashes are compared with the ones of a golden file
+//  written by an earlier '-update' run. Rendered frames must match exactly.
+//  The WebP output may change, e.g. with a different lossy encoder, as long as
+//  the PSNR / SSIM of its decoded frames against the rendered ones does not
+//  drop below the golden values by more than a threshold.
+//
+
+#include <algorithm>
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+#include <webp/demux.h>
+#include <webp/encode.h>
+#include <webp/mux.h>
+#include "lib/rlottie/inc/rlottie.h"
+#include "lib/rlottie/inc/rlottiecommon.h"
+#include "zlib.h"
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+// 64-bit FNV-1a.
+const uint64_t kHashSeed = 0xcbf29ce484222325ull;
+
+uint64_t Hash(const void *data, size_t size, uint64_t hash) {
+    const uint8_t *const bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template <typename T>
+uint64_t HashValue(const T &value, uint64_t hash) {
+    return Hash(&value, sizeof(value), hash);
+}
+
+uint64_t HashPath(const float *points, size_t num_floats,
+                  const char *elements, size_t num_elements, uint64_t hash) {
+    if (points != nullptr) hash = Hash(points, num_floats * sizeof(*points), hash);
+    if (elements != nullptr) hash = Hash(elements, num_elements, hash);
+    return HashValue(num_elements, HashValue(num_floats, hash));
+}
+
+uint64_t HashNode(const LOTNode &node, uint64_t hash) {
+    // LOTNode::mPath.ptCount counts floats.
+    hash = HashPath(node.mPath.ptPtr, node.mPath.ptCount, node.mPath.elmPtr,
+                    node.mPath.elmCount, hash);
+    hash = HashValue(node.mBrushType, HashValue(node.mFillRule, hash));
+    const uint8_t color[] = {node.mColor.r, node.mColor.g, node.mColor.b,
+                             node.mColor.a};
+    hash = Hash(color, sizeof(color), hash);
+    if (node.mStroke.enable) {
+        hash = HashValue(node.mStroke.width, hash);
+        hash = HashValue(node.mStroke.cap, HashValue(node.mStroke.join, hash));
+        hash = HashValue(node.mStroke.miterLimit, hash);
+        if (node.mStroke.dashArray != nullptr) {
+            hash = Hash(node.mStroke.dashArray,
+                        node.mStroke.dashArraySize * sizeof(float), hash);
+        }
+    }
+    if (node.mBrushType == BrushGradient) {
+        const auto &gradient = node.mGradient;
+        hash = HashValue(gradient.type, hash);
+        for (size_t i = 0; i < gradient.stopCount; ++i) {
+            const LOTGradientStop &stop = gradient.stopPtr[i];
+            const uint8_t rgba[] = {stop.r, stop.g, stop.b, stop.a};
+            hash = Hash(rgba, sizeof(rgba), HashValue(stop.pos, hash));
+        }
+        const float geometry[] = {gradient.start.x,  gradient.start.y,
+                                  gradient.end.x,    gradient.end.y,
+                                  gradient.center.x, gradient.center.y,
+                                  gradient.focal.x,  gradient.focal.y,
+                                  gradient.cradius,  gradient.fradius};
+        hash = Hash(geometry, sizeof(geometry), hash);
+    }
+    if (node.mImageInfo.data != nullptr) {
+        hash = HashValue(node.mImageInfo.width, hash);
+        hash = HashValue(node.mImageInfo.height, hash);
+        hash = HashValue(node.mImageInfo.mAlpha, hash);
+        hash = HashValue(node.mImageInfo.mMatrix, hash);
+    }
+    return hash;
+}
+
+uint64_t HashLayer(const LOTLayerNode &layer, uint64_t hash) {
+    hash = HashValue(layer.mVisible, HashValue(layer.mAlpha, hash));
+    hash = HashValue(layer.mMatte, hash);
+    for (size_t i = 0; i < layer.mMaskList.size; ++i) {
+        const LOTMask &mask = layer.mMaskList.ptr[i];
+        // LOTMask::mPath.ptCount counts points.
+        hash = HashPath(mask.mPath.ptPtr, 2 * mask.mPath.ptCount,
+                        mask.mPath.elmPtr, mask.mPath.elmCount, hash);
+        hash = HashValue(mask.mMode, HashValue(mask.mAlpha, hash));
+    }
+    hash = HashPath(layer.mClipPath.ptPtr, layer.mClipPath.ptCount,
+                    layer.mClipPath.elmPtr, layer.mClipPath.elmCount, hash);
+    for (size_t i = 0; i < layer.mNodeList.size; ++i) {
+        hash = HashNode(*layer.mNodeList.ptr[i], hash);
+    }
+    for (size_t i = 0; i < layer.mLayerList.size; ++i) {
+        hash = HashLayer(*layer.mLayerList.ptr[i], hash);
+    }
+    return hash;
+}
+
+struct Layer {
+    std::string name;
+    uint64_t hash = kHashSeed;  // of the layer's render tree in all frames
+};
+
+struct Frame {
+    uint64_t pixels = 0;
+    uint64_t tree = 0;
+};
+
+struct Golden {
+    std::string name;
+    std::vector<Frame> frames;
+    std::vector<Layer> layers;
+    uint64_t webp_hash = 0;
+    size_t webp_bytes = 0;
+    float psnr = 99.f;  // dB, lowest of the decoded WebP frames
+    float ssim = 99.f;
+};
+
+// Settings of a golden file, which are the ones checked against it.
+struct Settings {
+    int size = 128;
+    int mixed = 0;
+    float quality = 75.f;
+    int method = 0;
+    float psnr_drop = 1.f;  // dB, tolerated below the golden PSNR / SSIM
+    float ssim_drop = 1.f;
+};
+
+struct Distortion {
+    int frame = -1;  // of the lowest PSNR
+    float psnr = 99.f;
+    float ssim = 99.f;
+};
+
+bool EndsWith(const std::string &s, const char *suffix) {
+    const size_t n = strlen(suffix);
+    return s.size() > n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Appends the .json and .tgs files of 'path' to 'files'; 'path' may also be
+// one such file.
+void AddInputs(const std::string &path, std::vector<std::string> *files) {
+    DIR *const dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        files->push_back(path);
+        return;
+    }
+    std::vector<std::string> names;
+    while (const struct dirent *entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (EndsWith(name, ".json") || EndsWith(name, ".tgs")) {
+            names.push_back(path + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    files->insert(files->end(), names.begin(), names.end());
+}
+
+bool ReadInput(const std::string &path, std::string *json) {
+    gzFile file = gzopen(path.c_str(), "rb");  // Reads .json files as is.
+    if (file == nullptr) return false;
+    char buffer[16384];
+    int len;
+    while ((len = gzread(file, buffer, sizeof(buffer))) > 0) {
+        json->append(buffer, len);
+    }
+    const bool ok = (len == 0);
+    gzclose(file);
+    return ok && !json->empty();
+}
+
+bool ReadGolden(const char *path, Settings *settings,
+                std::vector<Golden> *goldens) {
+    FILE *const file = fopen(path, "r");
+    if (file == nullptr) return false;
+    char line[4096];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != nullptr) {
+        line[strcspn(line, "\n")] = '\0';
+        char name[1024];
+        uint64_t hash, tree;
+        size_t bytes;
+        float psnr, ssim;
+        int index, n;
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        } else if (sscanf(line, "settings size %d mixed %d q %f m %d psnr %f ssim %f",
+                          &settings->size, &settings->mixed,
+                          &settings->quality, &settings->method,
+                          &settings->psnr_drop, &settings->ssim_drop) == 6) {
+            continue;
+        } else if (sscanf(line, "file %1023s webp %" SCNx64 " %zu psnr %f "
+                          "ssim %f", name, &hash, &bytes, &psnr, &ssim) == 5) {
+            goldens->emplace_back();
+            goldens->back().name = name;
+            goldens->back().webp_hash = hash;
+            goldens->back().webp_bytes = bytes;
+            goldens->back().psnr = psnr;
+            goldens->back().ssim = ssim;
+        } else if (goldens->empty()) {
+            ok = false;
+        } else if (sscanf(line, "frame %d %" SCNx64 " %" SCNx64, &index,
+                          &hash, &tree) == 3) {
+            ok = (index == int(goldens->back().frames.size()));
+            goldens->back().frames.push_back({hash, tree});
+        } else if (sscanf(line, "layer %d %" SCNx64 " %n", &index, &hash,
+                          &n) == 2) {
+            goldens->back().layers.push_back({line + n, hash});
+        } else {
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+void WriteGolden(FILE *out, const Golden &golden) {
+    fprintf(out, "file %s webp %016" PRIx64 " %zu psnr %.2f ssim %.2f\n",
+            golden.name.c_str(), golden.webp_hash, golden.webp_bytes,
+            golden.psnr, golden.ssim);
+    for (size_t i = 0; i < golden.frames.size(); ++i) {
+        fprintf(out, "frame %zu %016" PRIx64 " %016" PRIx64 "\n", i,
+                golden.frames[i].pixels, golden.frames[i].tree);
+    }
+    for (size_t i = 0; i < golden.layers.size(); ++i) {
+        fprintf(out, "layer %zu %016" PRIx64 " %s\n", i,
+                golden.layers[i].hash, golden.layers[i].name.c_str());
+    }
+}
+
+// Renders all the frames of 'player' and hashes them and their render trees,
+// which 'tree_player' builds, so that 'player' renders exactly as in tgswebp.
+// The frames are also encoded into 'webp_data'.
+bool RenderAndEncode(rlottie::Animation *player,
+                     rlottie::Animation *tree_player, int size,
+                     const WebPConfig *config,
+                     const WebPAnimEncoderOptions *enc_options,
+                     Golden *result, WebPData *webp_data, int *frame_duration) {
+    const int total_frames = int(player->totalFrame());
+    const int duration = int(player->duration() * 1000);
+    *frame_duration = duration / std::max(total_frames, 1);
+    std::unique_ptr<uint32_t[]> buffer(new uint32_t[size * size]);
+    WebPAnimEncoder *enc = WebPAnimEncoderNew(size, size, enc_options);
+    int timestamp = 0;
+    bool ok = (enc != nullptr);
+    for (int i = 0; ok && i < total_frames; ++i) {
+        rlottie::Surface surface(buffer.get(), size, size, size * 4);
+        player->renderSync(i, surface);
+
+        Frame frame;
+        frame.pixels = Hash(buffer.get(), size * size * 4, kHashSeed);
+        frame.tree = kHashSeed;
+        const LOTLayerNode *root = tree_player->renderTree(i, size, size);
+        for (size_t l = 0; root != nullptr && l < root->mLayerList.size;
+             ++l) {
+            const LOTLayerNode &layer = *root->mLayerList.ptr[l];
+            if (l == result->layers.size()) {
+                result->layers.emplace_back();
+                result->layers[l].name = layer.keypath ? layer.keypath : "";
+            }
+            const uint64_t hash = HashLayer(layer, kHashSeed);
+            frame.tree = HashValue(hash, frame.tree);
+            result->layers[l].hash = HashValue(hash, result->layers[l].hash);
+        }
+        result->frames.push_back(frame);
+
+        WebPPicture picture;
+        ok = WebPPictureInit(&picture);
+        picture.width = size;
+        picture.height = size;
+        picture.use_argb = 1;
+        picture.argb = buffer.get();
+        picture.argb_stride = size;
+        ok = ok && WebPAnimEncoderAdd(enc, &picture, timestamp, config);
+        timestamp += *frame_duration;
+    }
+    ok = ok && WebPAnimEncoderAdd(enc, nullptr, timestamp, nullptr);
+    ok = ok && WebPAnimEncoderAssemble(enc, webp_data);
+    if (!ok) {
+        fprintf(stderr, "Error! Could not encode %s: %s\n",
+                result->name.c_str(),
+                enc != nullptr ? WebPAnimEncoderGetError(enc) : "");
+    }
+    WebPAnimEncoderDelete(enc);
+    result->webp_hash = Hash(webp_data->bytes, webp_data->size, kHashSeed);
+    result->webp_bytes = webp_data->size;
+    return ok;
+}
+
+// Measures the PSNR and SSIM of 'decoded' against the frames 'player' renders
+// from '*frame' up to the 'end_time' in ms, keeping the lowest in 'result'.
+bool CompareFramesUntil(const WebPPicture &decoded, WebPPicture *rendered,
+                        rlottie::Animation *player, int frame_duration,
+                        int end_time, int *frame, Distortion *result) {
+    const int total_frames = int(player->totalFrame());
+    const int size = rendered->width;
+    for (; *frame < total_frames && *frame * frame_duration < end_time;
+         ++*frame) {
+        rlottie::Surface surface(rendered->argb, size, size, size * 4);
+        player->renderSync(*frame, surface);
+        float psnr[5], ssim[5];
+        if (!WebPPictureDistortion(&decoded, rendered, 0, psnr) ||
+            !WebPPictureDistortion(&decoded, rendered, 1, ssim)) {
+            return false;
+        }
+        if (psnr[4] < result->psnr) {
+            result->psnr = psnr[4];
+            result->frame = *frame;
+        }
+        result->ssim = std::min(result->ssim, ssim[4]);
+    }
+    return true;
+}
+
+// Decodes 'webp_data' and measures the PSNR and SSIM of its frames against
+// the ones 'player' renders, keeping the lowest in 'result'. As rlottie may
+// render a frame differently depending on the frames rendered before it,
+// 'player' must be a new one, rendering in the same order as when encoding.
+bool MeasureDistortion(const WebPData &webp_data, rlottie::Animation *player,
+                       int size, int frame_duration, Distortion *result) {
+    WebPAnimDecoderOptions dec_options;
+    if (!WebPAnimDecoderOptionsInit(&dec_options)) return false;
+    // Same memory layout as the ARGB rendered by rlottie.
+    dec_options.color_mode = MODE_BGRA;
+    WebPAnimDecoder *const dec = WebPAnimDecoderNew(&webp_data, &dec_options);
+    if (dec == nullptr) return false;
+
+    std::unique_ptr<uint32_t[]> rendered(new uint32_t[size * size]);
+    std::unique_ptr<uint32_t[]> decoded(new uint32_t[size * size]());
+    WebPPicture ref, pic;
+    bool ok = WebPPictureInit(&ref) && WebPPictureInit(&pic);
+    ref.width = pic.width = size;
+    ref.height = pic.height = size;
+    ref.use_argb = pic.use_argb = 1;
+    ref.argb = rendered.get();
+    pic.argb = decoded.get();
+    ref.argb_stride = pic.argb_stride = size;
+
+    int frame = 0, timestamp;
+    uint8_t *canvas;
+    while (ok && WebPAnimDecoderHasMoreFrames(dec)) {
+        ok = WebPAnimDecoderGetNext(dec, &canvas, &timestamp);
+        if (!ok) break;
+        memcpy(decoded.get(), canvas, size * size * 4);
+        // The rendered frames are premultiplied, so the encoder is free to
+        // change the color of the transparent pixels.
+        for (int i = 0; i < size * size; ++i) {
+            if ((decoded[i] >> 24) == 0) decoded[i] = 0;
+        }
+        // Merged frames are compared with each of the frames they replace.
+        ok = CompareFramesUntil(pic, &ref, player, frame_duration, timestamp,
+                                &frame, result);
+    }
+    // An animation of transparent frames may have no frame at all.
+    ok = ok && CompareFramesUntil(pic, &ref, player, frame_duration, INT_MAX,
+                                  &frame, result);
+    WebPAnimDecoderDelete(dec);
+    return ok;
+}
+
+// Compares 'result' with 'golden' and prints the regressions, that is the
+// frames rendered differently, with the top level layers whose render trees
+// changed. Returns the number of regressions.
+int CompareFrames(const Golden &result, const Golden &golden) {
+    if (result.frames.size() != golden.frames.size()) {
+        fprintf(stderr, "REGRESSION %s: %zu frames, expected %zu\n",
+                result.name.c_str(), result.frames.size(),
+                golden.frames.size());
+        return 1;
+    }
+    std::string changed_layers;
+    for (size_t i = 0; i < result.layers.size(); ++i) {
+        if (i < golden.layers.size() &&
+            result.layers[i].hash == golden.layers[i].hash &&
+            result.layers[i].name == golden.layers[i].name) {
+            continue;
+        }
+        if (!changed_layers.empty()) changed_layers += ", ";
+        changed_layers += std::to_string(i) + " '" + result.layers[i].name + "'";
+    }
+    if (golden.layers.size() > result.layers.size()) {
+        if (!changed_layers.empty()) changed_layers += ", ";
+        changed_layers += std::to_string(golden.layers.size() -
+                                         result.layers.size()) + " removed";
+    }
+
+    int regressions = 0;
+    for (size_t i = 0; i < result.frames.size(); ++i) {
+        const Frame &frame = result.frames[i];
+        const Frame &expected = golden.frames[i];
+        if (frame.pixels == expected.pixels) continue;
+        fprintf(stderr, "REGRESSION %s frame %zu: pixels %016" PRIx64
+                " -> %016" PRIx64 ", ", result.name.c_str(), i,
+                expected.pixels, frame.pixels);
+        if (frame.tree == expected.tree) {
+            fprintf(stderr, "same render tree (rasterization or blending)\n");
+        } else {
+            fprintf(stderr, "render tree changed in layer(s) %s\n",
+                    changed_layers.c_str());
+        }
+        ++regressions;
+    }
+    return regressions;
+}
+
+void Help() {
+    printf("Usage:\n");
+    printf(" tgswebp_golden [options] [files or directories]\n");
+    printf("Renders every frame of each .json / .tgs file and encodes them as\n"
+           "tgswebp does, then compares the rendered frames and the WebP\n"
+           "output with a golden file. Without inputs, the bundled lottie\n"
+           "corpus is used. Exits with 1 on any regression, and on inputs\n"
+           "missing from the golden file; with the bundled corpus, also on\n"
+           "golden entries that no input matched.\n");
+    printf("Options:\n");
+    printf("  -h / -help ............. this help\n");
+    printf("  -golden <file> ......... golden file (default: "
+           "examples/golden.txt)\n");
+    printf("  -update ................ write the golden file instead of\n"
+           "                           checking against it\n");
+    printf("  -v ..................... print the PSNR and SSIM of every "
+           "file\n");
+    printf("Options of -update, later read from the golden file:\n");
+    printf("  -size <int> ............ frame width and height (default: 128)\n");
+    printf("  -mixed ................. encode with mixed compression\n");
+    printf("  -q <float> ............. quality factor (0:small..100:big)\n");
+    printf("  -m <int> ............... compression method (0=fast, 6=slowest)\n"
+           "                           (default: 0)\n");
+    printf("  -psnr <float> .......... PSNR drop in dB tolerated when the WebP\n"
+           "                           output changed (default: 1)\n");
+    printf("  -ssim <float> .......... SSIM drop in dB tolerated when the WebP\n"
+           "                           output changed (default: 1)\n");
+    printf("\n");
+}
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+
+int main(int argc, const char *argv[]) {
+    const char *golden_file = TGSWEBP_SOURCE_DIR "/examples/golden.txt";
+    bool update = false, verbose = false;
+    Settings settings;
+    std::vector<std::string> files;
+    std::vector<Golden> goldens;
+    WebPAnimEncoderOptions enc_options;
+    WebPConfig config;
+
+    if (!WebPConfigInit(&config) || !WebPAnimEncoderOptionsInit(&enc_options)) {
+        fprintf(stderr, "Error! Version mismatch!\n");
+        return 1;
+    }
+    for (int c = 1; c < argc; ++c) {
+        const bool has_value = (c < argc - 1);
+        if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
+            Help();
+            return 0;
+        } else if (!strcmp(argv[c], "-golden") && has_value) {
+            golden_file = argv[++c];
+        } else if (!strcmp(argv[c], "-update")) {
+            update = true;
+        } else if (!strcmp(argv[c], "-v")) {
+            verbose = true;
+        } else if (!strcmp(argv[c], "-size") && has_value) {
+            settings.size = std::max(atoi(argv[++c]), 1);
+        } else if (!strcmp(argv[c], "-mixed")) {
+            settings.mixed = 1;
+        } else if (!strcmp(argv[c], "-q") && has_value) {
+            settings.quality = float(atof(argv[++c]));
+        } else if (!strcmp(argv[c], "-m") && has_value) {
+            settings.method = atoi(argv[++c]);
+        } else if (!strcmp(argv[c], "-psnr") && has_value) {
+            settings.psnr_drop = float(atof(argv[++c]));
+        } else if (!strcmp(argv[c], "-ssim") && has_value) {
+            settings.ssim_drop = float(atof(argv[++c]));
+        } else if (argv[c][0] == '-') {
+            fprintf(stderr, "Error! Unknown option '%s'\n", argv[c]);
+            Help();
+            return 1;
+        } else {
+            AddInputs(argv[c], &files);
+        }
+    }
+    const bool corpus = files.empty();
+    if (corpus) {
+        AddInputs(TGSWEBP_SOURCE_DIR "/lib/rlottie/example/resource", &files);
+        AddInputs(TGSWEBP_SOURCE_DIR "/examples/1762", &files);
+    }
+    if (!update && !ReadGolden(golden_file, &settings, &goldens)) {
+        fprintf(stderr, "Error! Could not read '%s'\n", golden_file);
+        return 1;
+    }
+    // Same encoder settings as tgswebp.
+    enc_options.allow_mixed = settings.mixed;
+    config.lossless = !settings.mixed;
+    config.quality = settings.quality;
+    config.method = settings.method;
+    config.sns_strength = 90;
+    config.filter_sharpness = 6;
+    config.alpha_quality = 5;
+    if (!WebPValidateConfig(&config)) {
+        fprintf(stderr, "Error! Invalid configuration.\n");
+        return 1;
+    }
+
+    FILE *out = nullptr;
+    if (update) {
+        out = fopen(golden_file, "w");
+        if (out == nullptr) {
+            fprintf(stderr, "Error! Could not open '%s'\n", golden_file);
+            return 1;
+        }
+        fprintf(out, "# written by tgswebp_golden -update\n");
+        fprintf(out, "settings size %d mixed %d q %g m %d psnr %g ssim %g\n",
+                settings.size, settings.mixed, settings.quality,
+                settings.method, settings.psnr_drop, settings.ssim_drop);
+    }
+
+    int failures = 0, regressions = 0, frames = 0;
+    std::vector<bool> matched(goldens.size(), false);
+    for (const std::string &path : files) {
+        Golden result;
+        result.name = path.substr(path.find_last_of('/') + 1);
+        std::string json;
+        if (!ReadInput(path, &json)) {
+            fprintf(stderr, "Error! Could not read '%s'\n", path.c_str());
+            ++failures;
+            continue;
+        }
+        auto player = rlottie::Animation::loadFromData(json, path, "", false);
+        auto tree_player =
+            rlottie::Animation::loadFromData(json, path, "", false);
+        if (player == nullptr || tree_player == nullptr) {
+            fprintf(stderr, "Error! Could not parse '%s'\n", path.c_str());
+            ++failures;
+            continue;
+        }
+        WebPData webp_data;
+        WebPDataInit(&webp_data);
+        int frame_duration;
+        if (!RenderAndEncode(player.get(), tree_player.get(), settings.size,
+                             &config, &enc_options, &result, &webp_data,
+                             &frame_duration)) {
+            WebPDataClear(&webp_data);
+            ++failures;
+            continue;
+        }
+        frames += int(result.frames.size());
+
+        const Golden *golden = nullptr;
+        for (size_t i = 0; i < goldens.size(); ++i) {
+            if (goldens[i].name == result.name) {
+                golden = &goldens[i];
+                matched[i] = true;
+            }
+        }
+        // The WebP output is only measured when it changed.
+        const bool changed =
+            (golden != nullptr && result.webp_hash != golden->webp_hash);
+        Distortion distortion;
+        if (update || changed || verbose) {
+            player = rlottie::Animation::loadFromData(json, path, "", false);
+            if (!player ||
+                !MeasureDistortion(webp_data, player.get(), settings.size,
+                                   frame_duration, &distortion)) {
+                fprintf(stderr, "Error! Could not decode the WebP output of "
+                        "%s\n", result.name.c_str());
+                WebPDataClear(&webp_data);
+                ++failures;
+                continue;
+            }
+            result.psnr = distortion.psnr;
+            result.ssim = distortion.ssim;
+        }
+        WebPDataClear(&webp_data);
+
+        if (update) {
+            WriteGolden(out, result);
+        } else if (golden == nullptr) {
+            fprintf(stderr, "Error! %s is not in the golden file\n",
+                    result.name.c_str());
+            ++failures;
+            continue;
+        } else {
+            regressions += CompareFrames(result, *golden);
+        }
+        if (changed && (result.psnr < golden->psnr - settings.psnr_drop ||
+                        result.ssim < golden->ssim - settings.ssim_drop)) {
+            fprintf(stderr, "REGRESSION %s frame %d: WebP output PSNR %.2f "
+                    "-> %.2f dB, SSIM %.2f -> %.2f dB\n", result.name.c_str(),
+                    distortion.frame, golden->psnr, result.psnr, golden->ssim,
+                    result.ssim);
+            ++regressions;
+        } else if (changed || verbose) {
+            fprintf(stderr, "%s: WebP output %s%zu bytes, PSNR %.2f dB, SSIM "
+                    "%.2f dB\n", result.name.c_str(),
+                    changed ? "changed, " : "", result.webp_bytes,
+                    result.psnr, result.ssim);
+        }
+    }
+    // A file renamed or removed from the corpus leaves its entry behind.
+    for (size_t i = 0; corpus && i < goldens.size(); ++i) {
+        if (matched[i]) continue;
+        fprintf(stderr, "Error! No input matched %s of the golden file\n",
+                goldens[i].name.c_str());
+        ++failures;
+    }
+    if (out != nullptr && fclose(out) != 0) {
+        fprintf(stderr, "Error! Could not write '%s'\n", golden_file);
+        ++failures;
+    }
+
+    fprintf(stderr, "%zu files, %d frames: %d regression(s), %d error(s)\n",
+            files.size(), frames, regressions, failures);
+    return (regressions == 0 && failures == 0) ? 0 : 1;
+}
@@ -208,6 +208,7 @@ int VP8LHashChainInit(VP8LHashChain* const p, int size) {
       (uint32_t*)WebPSafeMalloc(size, sizeof(*p->offset_length_));
   if (p->offset_length_ == NULL) return 0;
   p->size_ = size;
+  p->hash_to_first_index_ = NULL;
 
   return 1;
 }
@@ -215,9 +216,11 @@ int VP8LHashChainInit(VP8LHashChain* const p, int size) {
 void VP8LHashChainClear(VP8LHashChain* const p) {
   assert(p != NULL);
   WebPSafeFree(p->offset_length_);
+  WebPSafeFree(p->hash_to_first_index_);
 
   p->size_ = 0;
   p->offset_length_ = NULL;
+  p->hash_to_first_index_ = NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -274,9 +277,12 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
     return 1;
   }
 
-  hash_to_first_index =
-      (int32_t*)WebPSafeMalloc(HASH_SIZE, sizeof(*hash_to_first_index));
-  if (hash_to_first_index == NULL) return 0;
+  if (p->hash_to_first_index_ == NULL) {
+    p->hash_to_first_index_ =
+        (int32_t*)WebPSafeMalloc(HASH_SIZE, sizeof(*hash_to_first_index));
+    if (p->hash_to_first_index_ == NULL) return 0;
+  }
+  hash_to_first_index = p->hash_to_first_index_;
 
   // Set the int32_t array to -1.
   memset(hash_to_first_index, 0xff, HASH_SIZE * sizeof(*hash_to_first_index));
@@ -327,8 +333,6 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
   // Process the penultimate pixel.
   chain[pos] = hash_to_first_index[GetPixPairHash64(argb + pos)];
 
-  WebPSafeFree(hash_to_first_index);
-
   // Find the best match interval at each pixel, defined by an offset to the
   // pixel and a length. The right-most pixel cannot match anything to the right
   // (hence a best length of 0) and the left-most pixel nothing to the left
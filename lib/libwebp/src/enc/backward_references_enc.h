@@ -130,6 +130,8 @@ struct VP8LHashChain {
   // This is the maximum size of the hash_chain that can be constructed.
   // Typically this is the pixel count (width x height) for a given image.
   int size_;
+  // Scratch memory of VP8LHashChainFill(), kept until VP8LHashChainClear().
+  int32_t* hash_to_first_index_;
 };
 
 // Must be called first, to set size.
@@ -143,14 +143,11 @@ static size_t HistogramSetTotalSize(int size, int cache_bits) {
           histo_size + WEBP_ALIGN_CST));
 }
 
-VP8LHistogramSet* VP8LAllocateHistogramSet(int size, int cache_bits) {
+// Lays out a set of 'size' histograms in 'memory'.
+static VP8LHistogramSet* HistogramSetInit(uint8_t* memory, int size,
+                                          int cache_bits) {
   int i;
-  VP8LHistogramSet* set;
-  const size_t total_size = HistogramSetTotalSize(size, cache_bits);
-  uint8_t* memory = (uint8_t*)WebPSafeMalloc(total_size, sizeof(*memory));
-  if (memory == NULL) return NULL;
-
-  set = (VP8LHistogramSet*)memory;
+  VP8LHistogramSet* const set = (VP8LHistogramSet*)memory;
   memory += sizeof(*set);
   set->histograms = (VP8LHistogram**)memory;
   set->max_size = size;
@@ -162,6 +159,30 @@ VP8LHistogramSet* VP8LAllocateHistogramSet(int size, int cache_bits) {
   return set;
 }
 
+VP8LHistogramSet* VP8LAllocateHistogramSet(int size, int cache_bits) {
+  const size_t total_size = HistogramSetTotalSize(size, cache_bits);
+  uint8_t* const memory = (uint8_t*)WebPSafeMalloc(total_size, sizeof(*memory));
+  if (memory == NULL) return NULL;
+  return HistogramSetInit(memory, size, cache_bits);
+}
+
+int VP8LReallocateHistogramSet(VP8LHistogramSet** const set,
+                               size_t* const set_mem_size, int size,
+                               int cache_bits) {
+  const size_t total_size = HistogramSetTotalSize(size, cache_bits);
+  uint8_t* memory = (uint8_t*)*set;
+  if (memory == NULL || total_size > *set_mem_size) {
+    WebPSafeFree(memory);
+    *set = NULL;
+    *set_mem_size = 0;
+    memory = (uint8_t*)WebPSafeMalloc(total_size, sizeof(*memory));
+    if (memory == NULL) return 0;
+    *set_mem_size = total_size;
+  }
+  *set = HistogramSetInit(memory, size, cache_bits);
+  return 1;
+}
+
 void VP8LHistogramSetClear(VP8LHistogramSet* const set) {
   int i;
   const int cache_bits = set->histograms[0]->palette_code_bits_;
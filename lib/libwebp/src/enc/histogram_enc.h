@@ -86,6 +86,13 @@ void VP8LFreeHistogramSet(VP8LHistogramSet* const histo);
 // using 'cache_bits'. Return NULL in case of memory error.
 VP8LHistogramSet* VP8LAllocateHistogramSet(int size, int cache_bits);
 
+// Same as VP8LAllocateHistogramSet(), but reuses the memory of '*set', of
+// '*set_mem_size' bytes, if it is large enough. Otherwise '*set' is freed and
+// reallocated. Returns false in case of memory error, '*set' being NULL then.
+int VP8LReallocateHistogramSet(VP8LHistogramSet** const set,
+                               size_t* const set_mem_size, int size,
+                               int cache_bits);
+
 // Set the histograms in set to 0.
 void VP8LHistogramSetClear(VP8LHistogramSet* const set);
 
@@ -26,6 +26,8 @@
 #include "src/utils/utils.h"
 #include "src/webp/format_constants.h"
 
+extern void VP8LClearBackwardRefs(VP8LBackwardRefs* const refs);
+
 // Maximum number of histogram images (sub-blocks).
 #define MAX_HUFF_IMAGE_SIZE       2600
 
@@ -118,18 +120,78 @@ static int PaletteHasNonMonotonousDeltas(uint32_t palette[], int num_colors) {
 // -----------------------------------------------------------------------------
 // Palette
 
+#define PALETTE_INV_SIZE_BITS 11
+#define PALETTE_INV_SIZE (1 << PALETTE_INV_SIZE_BITS)
+
+// Color to index lookup of a palette, see PreparePaletteLookup().
+typedef struct {
+  int hash_;                            // ApplyPaletteHash<hash_>() is a
+                                        // perfect hash if hash_ < 3.
+  uint16_t buffer_[PALETTE_INV_SIZE];   // Palette index of the hashed colors.
+  uint32_t sorted_[MAX_PALETTE_SIZE];   // Palette in increasing order, and
+  uint32_t idx_map_[MAX_PALETTE_SIZE];  // the matching palette indices.
+} PaletteLookup;
+
+// Encoders and palette kept from one picture to the next by a
+// WebPLosslessCache.
+struct WebPLosslessCache {
+  VP8LEncoder* enc_[2];  // For the main and the side thread of
+                         // VP8LEncodeStream().
+  // Palette of the last picture that used one. Pictures made of the same
+  // colors reuse its ordering and lookup instead of building them again.
+  uint32_t palette_[MAX_PALETTE_SIZE];
+  int palette_size_;                // 0 if there is no palette.
+  int palette_low_effort_;          // True if ordered with low effort.
+  PaletteLookup palette_lookup_;
+};
+
+// Returns true if 'cache' holds a palette of the 'num_colors' colors in
+// 'palette', ordered with the same effort.
+static int IsPaletteCached(const WebPLosslessCache* const cache,
+                           const uint32_t palette[], int num_colors,
+                           int low_effort) {
+  const uint32_t* const sorted = cache->palette_lookup_.sorted_;
+  int i;
+  if (cache->palette_size_ != num_colors ||
+      cache->palette_low_effort_ != low_effort) {
+    return 0;
+  }
+  // Both palettes hold distinct colors, so finding all of them is enough.
+  for (i = 0; i < num_colors; ++i) {
+    const uint32_t color = palette[i];
+    int low = 0, hi = num_colors;
+    while (low < hi) {
+      const int mid = (low + hi) >> 1;
+      if (sorted[mid] < color) {
+        low = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (low == num_colors || sorted[low] != color) return 0;
+  }
+  return 1;
+}
+
 // If number of colors in the image is less than or equal to MAX_PALETTE_SIZE,
 // creates a palette and returns true, else returns false.
 static int AnalyzeAndCreatePalette(const WebPPicture* const pic,
                                    int low_effort,
                                    uint32_t palette[MAX_PALETTE_SIZE],
                                    int* const palette_size) {
+  const WebPLosslessCache* const cache = pic->lossless_cache;
   const int num_colors = WebPGetColorPalette(pic, palette);
   if (num_colors > MAX_PALETTE_SIZE) {
     *palette_size = 0;
     return 0;
   }
   *palette_size = num_colors;
+  // The ordering below only depends on the set of colors.
+  if (cache != NULL &&
+      IsPaletteCached(cache, palette, num_colors, low_effort)) {
+    memcpy(palette, cache->palette_, num_colors * sizeof(*palette));
+    return 1;
+  }
   qsort(palette, num_colors, sizeof(*palette), PaletteCompareColorsForQsort);
   if (!low_effort && PaletteHasNonMonotonousDeltas(palette, num_colors)) {
     GreedyMinimizeDeltas(palette, num_colors);
@@ -460,9 +522,22 @@ static int EncoderInit(VP8LEncoder* const enc) {
   // at most MAX_REFS_BLOCK_PER_IMAGE blocks used:
   const int refs_block_size = (pix_cnt - 1) / MAX_REFS_BLOCK_PER_IMAGE + 1;
   int i;
-  if (!VP8LHashChainInit(&enc->hash_chain_, pix_cnt)) return 0;
+  // The scratch memory of an encoder reused from a WebPLosslessCache is kept
+  // if it is large enough.
+  if (enc->hash_chain_.size_ < pix_cnt) {
+    VP8LHashChainClear(&enc->hash_chain_);
+    if (!VP8LHashChainInit(&enc->hash_chain_, pix_cnt)) return 0;
+  }
 
-  for (i = 0; i < 4; ++i) VP8LBackwardRefsInit(&enc->refs_[i], refs_block_size);
+  for (i = 0; i < 4; ++i) {
+    VP8LBackwardRefs* const refs = &enc->refs_[i];
+    if (refs->block_size_ < refs_block_size) {
+      VP8LBackwardRefsClear(refs);
+      VP8LBackwardRefsInit(refs, refs_block_size);
+    } else {
+      VP8LClearBackwardRefs(refs);
+    }
+  }
 
   return 1;
 }
@@ -880,7 +955,9 @@ static WebPEncodingError EncodeImageInternal(
     VP8LHashChain* const hash_chain, VP8LBackwardRefs refs_array[4], int width,
     int height, int quality, int low_effort, int use_cache,
     const CrunchConfig* const config, int* cache_bits, int histogram_bits,
-    size_t init_byte_position, int* const hdr_size, int* const data_size) {
+    VP8LHistogramSet** const histogram_image_mem,
+    size_t* const histogram_image_mem_size, size_t init_byte_position,
+    int* const hdr_size, int* const data_size) {
   WebPEncodingError err = VP8_ENC_ERROR_OUT_OF_MEMORY;
   const uint32_t histogram_image_xysize =
       VP8LSubSampleSize(width, histogram_bits) *
@@ -950,10 +1027,14 @@ static WebPEncodingError EncodeImageInternal(
       VP8LBitWriterReset(&bw_init, bw);
 
       // Build histogram image and symbols from backward references.
-      histogram_image =
-          VP8LAllocateHistogramSet(histogram_image_xysize, cache_bits_tmp);
+      if (!VP8LReallocateHistogramSet(histogram_image_mem,
+                                      histogram_image_mem_size,
+                                      histogram_image_xysize, cache_bits_tmp)) {
+        goto Error;
+      }
+      histogram_image = *histogram_image_mem;
       tmp_histo = VP8LAllocateHistogram(cache_bits_tmp);
-      if (histogram_image == NULL || tmp_histo == NULL ||
+      if (tmp_histo == NULL ||
           !VP8LGetHistoImageSymbols(width, height, &refs_array[i_cache],
                                     quality, low_effort, histogram_bits,
                                     cache_bits_tmp, histogram_image, tmp_histo,
@@ -972,8 +1053,8 @@ static WebPEncodingError EncodeImageInternal(
           !GetHuffBitLengthsAndCodes(histogram_image, huffman_codes)) {
         goto Error;
       }
-      // Free combined histograms.
-      VP8LFreeHistogramSet(histogram_image);
+      // The combined histograms are not needed anymore; their memory is kept
+      // in 'histogram_image_mem' for the next iteration.
       histogram_image = NULL;
 
       // Free scratch histograms.
@@ -1064,7 +1145,6 @@ static WebPEncodingError EncodeImageInternal(
  Error:
   WebPSafeFree(tokens);
   WebPSafeFree(huff_tree);
-  VP8LFreeHistogramSet(histogram_image);
   VP8LFreeHistogram(tmp_histo);
   VP8LHashChainClear(&hash_chain_histogram);
   if (huffman_codes != NULL) {
@@ -1318,9 +1398,6 @@ static WEBP_INLINE uint32_t ApplyPaletteHash0(uint32_t color) {
   return (color >> 8) & 0xff;
 }
 
-#define PALETTE_INV_SIZE_BITS 11
-#define PALETTE_INV_SIZE (1 << PALETTE_INV_SIZE_BITS)
-
 static WEBP_INLINE uint32_t ApplyPaletteHash1(uint32_t color) {
   // Forget about alpha.
   return ((uint32_t)((color & 0x00ffffffu) * 4222244071ull)) >>
@@ -1344,6 +1421,52 @@ static void PrepareMapToPalette(const uint32_t palette[], int num_colors,
   }
 }
 
+// Builds the lookup from colors to indices of 'palette'.
+static void PreparePaletteLookup(const uint32_t palette[], int palette_size,
+                                 PaletteLookup* const lookup) {
+  int i, j;
+  uint32_t (*const hash_functions[])(uint32_t) = {
+      ApplyPaletteHash0, ApplyPaletteHash1, ApplyPaletteHash2
+  };
+
+  // Try to find a perfect hash function able to go from a color to an index
+  // within 1 << PALETTE_INV_SIZE_BITS in order to build a hash map to go
+  // from color to index in palette.
+  for (i = 0; i < 3; ++i) {
+    int use_LUT = 1;
+    // Set each element in buffer to max uint16_t.
+    memset(lookup->buffer_, 0xff, sizeof(lookup->buffer_));
+    for (j = 0; j < palette_size; ++j) {
+      const uint32_t ind = hash_functions[i](palette[j]);
+      if (lookup->buffer_[ind] != 0xffffu) {
+        use_LUT = 0;
+        break;
+      } else {
+        lookup->buffer_[ind] = j;
+      }
+    }
+    if (use_LUT) break;
+  }
+  lookup->hash_ = i;
+  PrepareMapToPalette(palette, palette_size, lookup->sorted_,
+                      lookup->idx_map_);
+}
+
+// Keeps 'palette' and its lookup in 'cache' for the next pictures.
+static void CachePalette(WebPLosslessCache* const cache,
+                         const uint32_t palette[], int palette_size,
+                         int low_effort) {
+  if (cache->palette_size_ == palette_size &&
+      cache->palette_low_effort_ == low_effort &&
+      !memcmp(cache->palette_, palette, palette_size * sizeof(*palette))) {
+    return;
+  }
+  memcpy(cache->palette_, palette, palette_size * sizeof(*palette));
+  cache->palette_size_ = palette_size;
+  cache->palette_low_effort_ = low_effort;
+  PreparePaletteLookup(palette, palette_size, &cache->palette_lookup_);
+}
+
 // Use 1 pixel cache for ARGB pixels.
 #define APPLY_PALETTE_FOR(COLOR_INDEX) do {         \
   uint32_t prev_pix = palette[0];                   \
@@ -1366,10 +1489,12 @@ static void PrepareMapToPalette(const uint32_t palette[], int num_colors,
 // Remap argb values in src[] to packed palettes entries in dst[]
 // using 'row' as a temporary buffer of size 'width'.
 // We assume that all src[] values have a corresponding entry in the palette.
+// 'lookup' is built from 'palette' if NULL.
 // Note: src[] can be the same as dst[]
 static WebPEncodingError ApplyPalette(const uint32_t* src, uint32_t src_stride,
                                       uint32_t* dst, uint32_t dst_stride,
                                       const uint32_t* palette, int palette_size,
+                                      const PaletteLookup* lookup,
                                       int width, int height, int xbits) {
   // TODO(skal): this tmp buffer is not needed if VP8LBundleColorMap() can be
   // made to work in-place.
@@ -1381,43 +1506,20 @@ static WebPEncodingError ApplyPalette(const uint32_t* src, uint32_t src_stride,
   if (palette_size < APPLY_PALETTE_GREEDY_MAX) {
     APPLY_PALETTE_FOR(SearchColorGreedy(palette, palette_size, pix));
   } else {
-    int i, j;
-    uint16_t buffer[PALETTE_INV_SIZE];
-    uint32_t (*const hash_functions[])(uint32_t) = {
-        ApplyPaletteHash0, ApplyPaletteHash1, ApplyPaletteHash2
-    };
-
-    // Try to find a perfect hash function able to go from a color to an index
-    // within 1 << PALETTE_INV_SIZE_BITS in order to build a hash map to go
-    // from color to index in palette.
-    for (i = 0; i < 3; ++i) {
-      int use_LUT = 1;
-      // Set each element in buffer to max uint16_t.
-      memset(buffer, 0xff, sizeof(buffer));
-      for (j = 0; j < palette_size; ++j) {
-        const uint32_t ind = hash_functions[i](palette[j]);
-        if (buffer[ind] != 0xffffu) {
-          use_LUT = 0;
-          break;
-        } else {
-          buffer[ind] = j;
-        }
-      }
-      if (use_LUT) break;
+    PaletteLookup tmp_lookup;
+    if (lookup == NULL) {
+      PreparePaletteLookup(palette, palette_size, &tmp_lookup);
+      lookup = &tmp_lookup;
     }
-
-    if (i == 0) {
-      APPLY_PALETTE_FOR(buffer[ApplyPaletteHash0(pix)]);
-    } else if (i == 1) {
-      APPLY_PALETTE_FOR(buffer[ApplyPaletteHash1(pix)]);
-    } else if (i == 2) {
-      APPLY_PALETTE_FOR(buffer[ApplyPaletteHash2(pix)]);
+    if (lookup->hash_ == 0) {
+      APPLY_PALETTE_FOR(lookup->buffer_[ApplyPaletteHash0(pix)]);
+    } else if (lookup->hash_ == 1) {
+      APPLY_PALETTE_FOR(lookup->buffer_[ApplyPaletteHash1(pix)]);
+    } else if (lookup->hash_ == 2) {
+      APPLY_PALETTE_FOR(lookup->buffer_[ApplyPaletteHash2(pix)]);
     } else {
-      uint32_t idx_map[MAX_PALETTE_SIZE];
-      uint32_t palette_sorted[MAX_PALETTE_SIZE];
-      PrepareMapToPalette(palette, palette_size, palette_sorted, idx_map);
-      APPLY_PALETTE_FOR(
-          idx_map[SearchColorNoIdx(palette_sorted, pix, palette_size)]);
+      APPLY_PALETTE_FOR(lookup->idx_map_[SearchColorNoIdx(lookup->sorted_, pix,
+                                                          palette_size)]);
     }
   }
   WebPSafeFree(tmp_row);
@@ -1439,6 +1541,13 @@ static WebPEncodingError MapImageFromPalette(VP8LEncoder* const enc,
   const uint32_t* src = in_place ? enc->argb_ : pic->argb;
   const int src_stride = in_place ? enc->current_width_ : pic->argb_stride;
   const int palette_size = enc->palette_size_;
+  const WebPLosslessCache* const cache = pic->lossless_cache;
+  // The cache is only modified once all the threads are done.
+  const PaletteLookup* const lookup =
+      (cache != NULL && cache->palette_size_ == palette_size &&
+       !memcmp(cache->palette_, palette, palette_size * sizeof(*palette)))
+          ? &cache->palette_lookup_
+          : NULL;
   int xbits;
 
   // Replace each input pixel by corresponding palette index.
@@ -1454,7 +1563,7 @@ static WebPEncodingError MapImageFromPalette(VP8LEncoder* const enc,
 
   err = ApplyPalette(src, src_stride,
                      enc->argb_, enc->current_width_,
-                     palette, palette_size, width, height, xbits);
+                     palette, palette_size, lookup, width, height, xbits);
   enc->argb_content_ = kEncoderPalette;
   return err;
 }
@@ -1482,12 +1591,43 @@ static WebPEncodingError EncodePalette(VP8LBitWriter* const bw, int low_effort,
 // -----------------------------------------------------------------------------
 // VP8LEncoder
 
+// Resets all the fields of 'enc' but its scratch memory.
+static void EncoderResetForReuse(VP8LEncoder* const enc) {
+  uint32_t* const transform_mem = enc->transform_mem_;
+  const size_t transform_mem_size = enc->transform_mem_size_;
+  const VP8LHashChain hash_chain = enc->hash_chain_;
+  VP8LHistogramSet* const histogram_image = enc->histogram_image_;
+  const size_t histogram_image_mem_size = enc->histogram_image_mem_size_;
+  VP8LBackwardRefs refs[4];
+  // The refs are restored at the same address, so the pointers they hold into
+  // themselves remain valid.
+  memcpy(refs, enc->refs_, sizeof(refs));
+  memset(enc, 0, sizeof(*enc));
+  enc->transform_mem_ = transform_mem;
+  enc->transform_mem_size_ = transform_mem_size;
+  enc->hash_chain_ = hash_chain;
+  enc->histogram_image_ = histogram_image;
+  enc->histogram_image_mem_size_ = histogram_image_mem_size;
+  memcpy(enc->refs_, refs, sizeof(refs));
+}
+
+// Returns a new encoder, or the one kept in slot 'cache_index' of the
+// picture's lossless cache if any.
 static VP8LEncoder* VP8LEncoderNew(const WebPConfig* const config,
-                                   const WebPPicture* const picture) {
-  VP8LEncoder* const enc = (VP8LEncoder*)WebPSafeCalloc(1ULL, sizeof(*enc));
-  if (enc == NULL) {
-    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-    return NULL;
+                                   const WebPPicture* const picture,
+                                   int cache_index) {
+  WebPLosslessCache* const cache = picture->lossless_cache;
+  VP8LEncoder* enc;
+  if (cache != NULL && cache->enc_[cache_index] != NULL) {
+    enc = cache->enc_[cache_index];
+    cache->enc_[cache_index] = NULL;
+    EncoderResetForReuse(enc);
+  } else {
+    enc = (VP8LEncoder*)WebPSafeCalloc(1ULL, sizeof(*enc));
+    if (enc == NULL) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      return NULL;
+    }
   }
   enc->config_ = config;
   enc->pic_ = picture;
@@ -1498,16 +1638,42 @@ static VP8LEncoder* VP8LEncoderNew(const WebPConfig* const config,
   return enc;
 }
 
-static void VP8LEncoderDelete(VP8LEncoder* enc) {
+static void EncoderFree(VP8LEncoder* const enc) {
   if (enc != NULL) {
     int i;
     VP8LHashChainClear(&enc->hash_chain_);
     for (i = 0; i < 4; ++i) VP8LBackwardRefsClear(&enc->refs_[i]);
+    VP8LFreeHistogramSet(enc->histogram_image_);
     ClearTransformBuffer(enc);
     WebPSafeFree(enc);
   }
 }
 
+// Gives 'enc' back to slot 'cache_index' of the picture's lossless cache, or
+// frees it if there is none.
+static void VP8LEncoderDelete(VP8LEncoder* enc, int cache_index) {
+  if (enc != NULL) {
+    WebPLosslessCache* const cache = enc->pic_->lossless_cache;
+    if (cache != NULL && cache->enc_[cache_index] == NULL) {
+      cache->enc_[cache_index] = enc;
+    } else {
+      EncoderFree(enc);
+    }
+  }
+}
+
+WebPLosslessCache* WebPLosslessCacheNew(void) {
+  return (WebPLosslessCache*)WebPSafeCalloc(1ULL, sizeof(WebPLosslessCache));
+}
+
+void WebPLosslessCacheDelete(WebPLosslessCache* cache) {
+  if (cache != NULL) {
+    EncoderFree(cache->enc_[0]);
+    EncoderFree(cache->enc_[1]);
+    WebPSafeFree(cache);
+  }
+}
+
 // -----------------------------------------------------------------------------
 // Main call
 
@@ -1578,8 +1744,8 @@ static int EncodeStreamHook(void* input, void* data2) {
     }
     // Reset any parameter in the encoder that is set in the previous iteration.
     enc->cache_bits_ = 0;
-    VP8LBackwardRefsClear(&enc->refs_[0]);
-    VP8LBackwardRefsClear(&enc->refs_[1]);
+    VP8LClearBackwardRefs(&enc->refs_[0]);
+    VP8LClearBackwardRefs(&enc->refs_[1]);
 
 #if (WEBP_NEAR_LOSSLESS == 1)
     // Apply near-lossless preprocessing.
@@ -1649,7 +1815,9 @@ static int EncodeStreamHook(void* input, void* data2) {
                               enc->current_width_, height, quality, low_effort,
                               use_cache, &crunch_configs[idx],
                               &enc->cache_bits_, enc->histo_bits_,
-                              byte_position, &hdr_size, &data_size);
+                              &enc->histogram_image_,
+                              &enc->histogram_image_mem_size_, byte_position,
+                              &hdr_size, &data_size);
     if (err != VP8_ENC_OK) goto Error;
 
     // If we are better than what we already have.
@@ -1692,7 +1860,7 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
                                    VP8LBitWriter* const bw_main,
                                    int use_cache) {
   WebPEncodingError err = VP8_ENC_OK;
-  VP8LEncoder* const enc_main = VP8LEncoderNew(config, picture);
+  VP8LEncoder* const enc_main = VP8LEncoderNew(config, picture, 0);
   VP8LEncoder* enc_side = NULL;
   CrunchConfig crunch_configs[CRUNCH_CONFIGS_MAX];
   int num_crunch_configs_main, num_crunch_configs_side = 0;
@@ -1756,7 +1924,7 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
         }
         param->bw_ = &bw_side;
         // Create a side encoder.
-        enc_side = VP8LEncoderNew(config, picture);
+        enc_side = VP8LEncoderNew(config, picture, 1);
         if (enc_side == NULL || !EncoderInit(enc_side)) {
           err = VP8_ENC_ERROR_OUT_OF_MEMORY;
           goto Error;
@@ -1820,11 +1988,15 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
       goto Error;
     }
   }
+  if (picture->lossless_cache != NULL && enc_main->palette_size_ > 0) {
+    CachePalette(picture->lossless_cache, enc_main->palette_,
+                 enc_main->palette_size_, config->method == 0);
+  }
 
 Error:
   VP8LBitWriterWipeOut(&bw_side);
-  VP8LEncoderDelete(enc_main);
-  VP8LEncoderDelete(enc_side);
+  VP8LEncoderDelete(enc_main, 0);
+  VP8LEncoderDelete(enc_side, 1);
   return err;
 }
 
@@ -74,6 +74,9 @@ typedef struct {
   struct VP8LBackwardRefs refs_[4];  // Backward Refs array for temporaries.
   VP8LHashChain hash_chain_;         // HashChain data for constructing
                                      // backward references.
+  VP8LHistogramSet* histogram_image_;  // Histogram image memory, kept from
+  size_t histogram_image_mem_size_;    // one EncodeImageInternal() call to
+                                       // the next.
 } VP8LEncoder;
 
 //------------------------------------------------------------------------------
@@ -12,17 +12,24 @@
 
 #include <assert.h>
 #include <limits.h>
-#include <math.h>    // for pow()
+#include <math.h>    // for log(), pow()
 #include <stdio.h>
 #include <stdlib.h>  // for abs()
 
 #include "src/mux/animi.h"
+#include "src/utils/thread_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/decode.h"
 #include "src/webp/encode.h"
 #include "src/webp/format_constants.h"
 #include "src/webp/mux.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
 #if defined(_MSC_VER) && _MSC_VER < 1900
 #define snprintf _snprintf
 #endif
@@ -43,8 +50,39 @@ typedef struct {
   WebPMuxFrameInfo sub_frame_;  // Encoded frame rectangle.
   WebPMuxFrameInfo key_frame_;  // Encoded frame if it is a key-frame.
   int is_key_frame_;            // True if 'key_frame' has been chosen.
+  int candidate_[2];            // Candidate picked for 'sub_frame_' and
+                                // 'key_frame_'; -1 if reused.
+  size_t stats_index_;          // 1 + index of the frame's statistics in
+                                // 'frame_stats_', 0 if none.
 } EncodedFrame;
 
+// An encoded sub-frame kept for reuse by a later frame with the same content
+// on the same previous canvas. Canvases are identified by a hash of their
+// pixels.
+typedef struct {
+  uint64_t prev_hash_;          // Hash of the previous canvas.
+  uint64_t curr_hash_;          // Hash of the current canvas.
+  FrameRectangle prev_rect_;    // Previous frame rectangle; only compared if
+                                // 'dispose_bg_possible_'.
+  int dispose_bg_possible_;     // True if dispose-to-background was tried.
+  WebPConfig config_;           // Config the frame was encoded with.
+  WebPMuxFrameInfo sub_frame_;  // Encoded frame. Owns the bitstream.
+  FrameRectangle rect_;         // Frame rectangle of 'sub_frame_'.
+  FrameRectangle changed_rect_;     // Pixels that differ from the previous
+                                    // canvas.
+  WebPMuxAnimDispose prev_dispose_;  // Dispose method picked for the previous
+                                     // frame.
+} ReusedFrame;
+
+// Candidates tried for each frame, in the order of WebPAnimCandidate.
+enum {
+  LL_DISP_NONE = 0,
+  LL_DISP_BG,
+  LOSSY_DISP_NONE,
+  LOSSY_DISP_BG,
+  CANDIDATE_COUNT
+};
+
 struct WebPAnimEncoder {
   const int canvas_width_;                  // Canvas width.
   const int canvas_height_;                 // Canvas height.
@@ -58,14 +96,28 @@ struct WebPAnimEncoder {
                                       // is true.
 
   WebPPicture* curr_canvas_;          // Only pointer; we don't own memory.
+  uint64_t curr_hash_;                // Hash of 'curr_canvas_' pixels.
 
-  // Canvas buffers.
-  WebPPicture curr_canvas_copy_;      // Possibly modified current canvas.
-  int curr_canvas_copy_modified_;     // True if pixels in 'curr_canvas_copy_'
-                                      // differ from those in 'curr_canvas_'.
+  // Canvas buffers. The current canvas is only read; each candidate copies
+  // its frame rectangle to a private canvas before modifying it.
+  WebPPicture curr_canvas_copy_;      // Scratch canvas for
+                                      // OptimizeSingleFrame().
+  FrameRectangle changed_rect_;       // Pixels of 'curr_canvas_' that differ
+                                      // from 'prev_canvas_'.
 
   WebPPicture prev_canvas_;           // Previous canvas.
+  uint64_t prev_hash_;                // Hash of 'prev_canvas_' pixels.
   WebPPicture prev_canvas_disposed_;  // Previous canvas disposed to background.
+  FrameRectangle disposed_dirty_rect_;  // Outside of this rectangle,
+                                        // 'prev_canvas_disposed_' and
+                                        // 'prev_canvas_' are the same.
+
+  // Candidate encoding, indexed by [is_key_frame][candidate].
+  WebPPicture candidate_canvas_[2][CANDIDATE_COUNT];  // Private copies of the
+                                                      // current canvas.
+  WebPWorker candidate_workers_[2][CANDIDATE_COUNT];  // Used to encode the
+                                                      // candidates
+                                                      // concurrently.
 
   // Encoded data.
   EncodedFrame* encoded_frames_;      // Array of encoded frames.
@@ -92,11 +144,34 @@ struct WebPAnimEncoder {
   int got_null_frame_;  // True if WebPAnimEncoderAdd() has already been called
                         // with a NULL frame.
 
+  // Frames kept for reuse, if 'options_.reuse_frames' is true.
+  ReusedFrame* reused_frames_;
+  int num_reused_frames_;   // Number of valid entries in 'reused_frames_'.
+  int reused_frames_size_;  // Number of allocated entries.
+  int num_lookups_;         // Frames looked up in 'reused_frames_'.
+  int num_reuses_;          // Frames whose encoding was reused.
+
+  // Lossless/lossy prediction statistics, when benchmarking the predictor.
+  int num_predicted_;       // Frames for which a prediction was made.
+  int num_correct_;         // Predictions that picked the smaller candidate.
+  int num_undecided_;       // Frames the predictor left undecided.
+  int64_t lost_bytes_;      // Bytes lost on wrong predictions.
+
+  // Per-frame statistics, if 'options_.frame_stats' is true.
+  WebPAnimFrameStats* frame_stats_;
+  int num_frame_stats_;     // Number of valid entries in 'frame_stats_'.
+  int frame_stats_size_;    // Number of allocated entries.
+  WebPAnimFrameStats* curr_stats_;  // Entry of the frame being added, or NULL.
+
   size_t in_frame_count_;   // Number of input frames processed so far.
   size_t out_frame_count_;  // Number of frames added to mux so far. This may be
                             // different from 'in_frame_count_' due to merging.
 
   WebPMux* mux_;        // Muxer to assemble the WebP bitstream.
+  size_t mux_bytes_;        // Bitstream bytes copied into 'mux_'.
+  size_t candidate_bytes_;  // Largest total of the candidates of a frame.
+  size_t peak_bytes_;       // Highest total memory held, see
+                            // WebPAnimEncoderGetMemory().
   char error_str_[ERROR_STR_MAX_LENGTH];  // Error string. Empty if no error.
 };
 
@@ -178,6 +253,9 @@ static void DefaultEncoderOptions(WebPAnimEncoderOptions* const enc_options) {
   DisableKeyframes(enc_options);
   enc_options->allow_mixed = 0;
   enc_options->verbose = 0;
+  enc_options->mixed_predictor = 1;
+  enc_options->reuse_frames = 1;
+  enc_options->frame_stats = 0;
 }
 
 int WebPAnimEncoderOptionsInitInternal(WebPAnimEncoderOptions* enc_options,
@@ -237,6 +315,7 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
     int width, int height, const WebPAnimEncoderOptions* enc_options,
     int abi_version) {
   WebPAnimEncoder* enc;
+  int i, c;
 
   if (WEBP_ABI_IS_INCOMPATIBLE(abi_version, WEBP_MUX_ABI_VERSION)) {
     return NULL;
@@ -278,7 +357,16 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
     goto Err;
   }
   WebPUtilClearPic(&enc->prev_canvas_, NULL);
-  enc->curr_canvas_copy_modified_ = 1;
+  enc->disposed_dirty_rect_.width_ = width;
+  enc->disposed_dirty_rect_.height_ = height;
+
+  // Candidate canvases are allocated on first use.
+  for (i = 0; i < 2; ++i) {
+    for (c = 0; c < CANDIDATE_COUNT; ++c) {
+      if (!WebPPictureInit(&enc->candidate_canvas_[i][c])) goto Err;
+      WebPGetWorkerInterface()->Init(&enc->candidate_workers_[i][c]);
+    }
+  }
 
   // Encoded frames.
   ResetCounters(enc);
@@ -319,9 +407,18 @@ static void FrameRelease(EncodedFrame* const encoded_frame) {
 
 void WebPAnimEncoderDelete(WebPAnimEncoder* enc) {
   if (enc != NULL) {
+    int k, c;
     WebPPictureFree(&enc->curr_canvas_copy_);
     WebPPictureFree(&enc->prev_canvas_);
     WebPPictureFree(&enc->prev_canvas_disposed_);
+    for (k = 0; k < 2; ++k) {
+      for (c = 0; c < CANDIDATE_COUNT; ++c) {
+        WebPPicture* const canvas = &enc->candidate_canvas_[k][c];
+        WebPGetWorkerInterface()->End(&enc->candidate_workers_[k][c]);
+        WebPLosslessCacheDelete(canvas->lossless_cache);
+        WebPPictureFree(canvas);
+      }
+    }
     if (enc->encoded_frames_ != NULL) {
       size_t i;
       for (i = 0; i < enc->size_; ++i) {
@@ -329,6 +426,14 @@ void WebPAnimEncoderDelete(WebPAnimEncoder* enc) {
       }
       WebPSafeFree(enc->encoded_frames_);
     }
+    if (enc->reused_frames_ != NULL) {
+      int i;
+      for (i = 0; i < enc->num_reused_frames_; ++i) {
+        WebPDataClear(&enc->reused_frames_[i].sub_frame_.bitstream);
+      }
+      WebPSafeFree(enc->reused_frames_);
+    }
+    WebPSafeFree(enc->frame_stats_);
     WebPMuxDelete(enc->mux_);
     WebPSafeFree(enc);
   }
@@ -344,27 +449,6 @@ static EncodedFrame* GetFrame(const WebPAnimEncoder* const enc,
   return &enc->encoded_frames_[enc->start_ + position];
 }
 
-typedef int (*ComparePixelsFunc)(const uint32_t*, int, const uint32_t*, int,
-                                 int, int);
-
-// Returns true if 'length' number of pixels in 'src' and 'dst' are equal,
-// assuming the given step sizes between pixels.
-// 'max_allowed_diff' is unused and only there to allow function pointer use.
-static WEBP_INLINE int ComparePixelsLossless(const uint32_t* src, int src_step,
-                                             const uint32_t* dst, int dst_step,
-                                             int length, int max_allowed_diff) {
-  (void)max_allowed_diff;
-  assert(length > 0);
-  while (length-- > 0) {
-    if (*src != *dst) {
-      return 0;
-    }
-    src += src_step;
-    dst += dst_step;
-  }
-  return 1;
-}
-
 // Helper to check if each channel in 'src' and 'dst' is at most off by
 // 'max_allowed_diff'.
 static WEBP_INLINE int PixelsAreSimilar(uint32_t src, uint32_t dst,
@@ -384,22 +468,6 @@ static WEBP_INLINE int PixelsAreSimilar(uint32_t src, uint32_t dst,
          (abs(src_b - dst_b) * dst_a <= (max_allowed_diff * 255));
 }
 
-// Returns true if 'length' number of pixels in 'src' and 'dst' are within an
-// error bound, assuming the given step sizes between pixels.
-static WEBP_INLINE int ComparePixelsLossy(const uint32_t* src, int src_step,
-                                          const uint32_t* dst, int dst_step,
-                                          int length, int max_allowed_diff) {
-  assert(length > 0);
-  while (length-- > 0) {
-    if (!PixelsAreSimilar(*src, *dst, max_allowed_diff)) {
-      return 0;
-    }
-    src += src_step;
-    dst += dst_step;
-  }
-  return 1;
-}
-
 static int IsEmptyRect(const FrameRectangle* const rect) {
   return (rect->width_ == 0) || (rect->height_ == 0);
 }
@@ -410,90 +478,77 @@ static int QualityToMaxDiff(float quality) {
   return (int)(max_diff + 0.5);
 }
 
-// Assumes that an initial valid guess of change rectangle 'rect' is passed.
-static void MinimizeChangeRectangle(const WebPPicture* const src,
-                                    const WebPPicture* const dst,
-                                    FrameRectangle* const rect,
-                                    int is_lossless, float quality) {
-  int i, j;
-  const ComparePixelsFunc compare_pixels =
-      is_lossless ? ComparePixelsLossless : ComparePixelsLossy;
-  const int max_allowed_diff_lossy = QualityToMaxDiff(quality);
-  const int max_allowed_diff = is_lossless ? 0 : max_allowed_diff_lossy;
+// Shrinks the initial guess 'rect_ll' to the bounding box of the pixels that
+// differ between 'src' and 'dst', and sets 'rect_lossy' to the bounding box of
+// the pixels that are not similar enough for lossy encoding at 'quality'. Both
+// are found in a single row-major pass; an empty box is all zeros.
+static void MinimizeChangeRectangles(const WebPPicture* const src,
+                                     const WebPPicture* const dst,
+                                     FrameRectangle* const rect_ll,
+                                     FrameRectangle* const rect_lossy,
+                                     float quality) {
+  const int max_allowed_diff = QualityToMaxDiff(quality);
+  const int x_start = rect_ll->x_offset_;
+  const int x_end = x_start + rect_ll->width_;
+  const int y_start = rect_ll->y_offset_;
+  const int y_end = y_start + rect_ll->height_;
+  // Inclusive bounds, empty as long as 'top' is 'y_end'.
+  int ll_left = x_end, ll_right = x_start - 1;
+  int ll_top = y_end, ll_bottom = y_start - 1;
+  int lossy_left = x_end, lossy_right = x_start - 1;
+  int lossy_top = y_end, lossy_bottom = y_start - 1;
+  int y;
 
   // Sanity checks.
   assert(src->width == dst->width && src->height == dst->height);
-  assert(rect->x_offset_ + rect->width_ <= dst->width);
-  assert(rect->y_offset_ + rect->height_ <= dst->height);
-
-  // Left boundary.
-  for (i = rect->x_offset_; i < rect->x_offset_ + rect->width_; ++i) {
-    const uint32_t* const src_argb =
-        &src->argb[rect->y_offset_ * src->argb_stride + i];
-    const uint32_t* const dst_argb =
-        &dst->argb[rect->y_offset_ * dst->argb_stride + i];
-    if (compare_pixels(src_argb, src->argb_stride, dst_argb, dst->argb_stride,
-                       rect->height_, max_allowed_diff)) {
-      --rect->width_;  // Redundant column.
-      ++rect->x_offset_;
-    } else {
-      break;
-    }
-  }
-  if (rect->width_ == 0) goto NoChange;
-
-  // Right boundary.
-  for (i = rect->x_offset_ + rect->width_ - 1; i >= rect->x_offset_; --i) {
-    const uint32_t* const src_argb =
-        &src->argb[rect->y_offset_ * src->argb_stride + i];
-    const uint32_t* const dst_argb =
-        &dst->argb[rect->y_offset_ * dst->argb_stride + i];
-    if (compare_pixels(src_argb, src->argb_stride, dst_argb, dst->argb_stride,
-                       rect->height_, max_allowed_diff)) {
-      --rect->width_;  // Redundant column.
-    } else {
-      break;
+  assert(x_end <= dst->width);
+  assert(y_end <= dst->height);
+
+  for (y = y_start; y < y_end && x_start < x_end; ++y) {
+    const uint32_t* const src_row = &src->argb[y * src->argb_stride];
+    const uint32_t* const dst_row = &dst->argb[y * dst->argb_stride];
+    int left, right, x;
+    if (!memcmp(src_row + x_start, dst_row + x_start,
+                (x_end - x_start) * sizeof(*src_row))) {
+      continue;  // Redundant row.
     }
-  }
-  if (rect->width_ == 0) goto NoChange;
-
-  // Top boundary.
-  for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
-    const uint32_t* const src_argb =
-        &src->argb[j * src->argb_stride + rect->x_offset_];
-    const uint32_t* const dst_argb =
-        &dst->argb[j * dst->argb_stride + rect->x_offset_];
-    if (compare_pixels(src_argb, 1, dst_argb, 1, rect->width_,
-                       max_allowed_diff)) {
-      --rect->height_;  // Redundant row.
-      ++rect->y_offset_;
-    } else {
-      break;
+    // The row has at least one differing pixel.
+    for (left = x_start; src_row[left] == dst_row[left]; ++left) {}
+    for (right = x_end - 1; src_row[right] == dst_row[right]; --right) {}
+    if (ll_top == y_end) ll_top = y;
+    ll_bottom = y;
+    if (left < ll_left) ll_left = left;
+    if (right > ll_right) ll_right = right;
+
+    // Pixels that are not similar are among the differing ones.
+    for (x = left; x <= right; ++x) {
+      if (!PixelsAreSimilar(src_row[x], dst_row[x], max_allowed_diff)) break;
     }
-  }
-  if (rect->height_ == 0) goto NoChange;
-
-  // Bottom boundary.
-  for (j = rect->y_offset_ + rect->height_ - 1; j >= rect->y_offset_; --j) {
-    const uint32_t* const src_argb =
-        &src->argb[j * src->argb_stride + rect->x_offset_];
-    const uint32_t* const dst_argb =
-        &dst->argb[j * dst->argb_stride + rect->x_offset_];
-    if (compare_pixels(src_argb, 1, dst_argb, 1, rect->width_,
-                       max_allowed_diff)) {
-      --rect->height_;  // Redundant row.
-    } else {
-      break;
+    if (x > right) continue;
+    if (lossy_top == y_end) lossy_top = y;
+    lossy_bottom = y;
+    if (x < lossy_left) lossy_left = x;
+    for (x = right; x > lossy_right; --x) {
+      if (!PixelsAreSimilar(src_row[x], dst_row[x], max_allowed_diff)) {
+        lossy_right = x;
+        break;
+      }
     }
   }
-  if (rect->height_ == 0) goto NoChange;
 
-  if (IsEmptyRect(rect)) {
- NoChange:
-    rect->x_offset_ = 0;
-    rect->y_offset_ = 0;
-    rect->width_ = 0;
-    rect->height_ = 0;
+  memset(rect_ll, 0, sizeof(*rect_ll));
+  memset(rect_lossy, 0, sizeof(*rect_lossy));
+  if (ll_top != y_end) {
+    rect_ll->x_offset_ = ll_left;
+    rect_ll->y_offset_ = ll_top;
+    rect_ll->width_ = ll_right - ll_left + 1;
+    rect_ll->height_ = ll_bottom - ll_top + 1;
+  }
+  if (lossy_top != y_end) {
+    rect_lossy->x_offset_ = lossy_left;
+    rect_lossy->y_offset_ = lossy_top;
+    rect_lossy->width_ = lossy_right - lossy_left + 1;
+    rect_lossy->height_ = lossy_bottom - lossy_top + 1;
   }
 }
 
@@ -532,22 +587,11 @@ static void SubFrameParamsFree(SubFrameParams* const params) {
   WebPPictureFree(&params->sub_frame_lossy_);
 }
 
-// Given previous and current canvas, picks the optimal rectangle for the
-// current frame based on 'is_lossless' and other parameters. Assumes that the
-// initial guess 'rect' is valid.
-static int GetSubRect(const WebPPicture* const prev_canvas,
-                      const WebPPicture* const curr_canvas, int is_key_frame,
-                      int is_first_frame, int empty_rect_allowed,
-                      int is_lossless, float quality,
-                      FrameRectangle* const rect,
+// Gets the 'sub_frame' of the current canvas for 'rect', which may be
+// replaced by a 1x1 rectangle if it is empty and 'empty_rect_allowed' is false.
+static int GetSubRect(const WebPPicture* const curr_canvas,
+                      int empty_rect_allowed, FrameRectangle* const rect,
                       WebPPicture* const sub_frame) {
-  if (!is_key_frame || is_first_frame) {  // Optimize frame rectangle.
-    // Note: This behaves as expected for first frame, as 'prev_canvas' is
-    // initialized to a fully transparent canvas in the beginning.
-    MinimizeChangeRectangle(prev_canvas, curr_canvas, rect,
-                            is_lossless, quality);
-  }
-
   if (IsEmptyRect(rect)) {
     if (empty_rect_allowed) {  // No need to get 'sub_frame'.
       return 1;
@@ -570,20 +614,21 @@ static int GetSubRects(const WebPPicture* const prev_canvas,
                        const WebPPicture* const curr_canvas, int is_key_frame,
                        int is_first_frame, float quality,
                        SubFrameParams* const params) {
-  // Lossless frame rectangle.
   params->rect_ll_.x_offset_ = 0;
   params->rect_ll_.y_offset_ = 0;
   params->rect_ll_.width_ = curr_canvas->width;
   params->rect_ll_.height_ = curr_canvas->height;
-  if (!GetSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
-                  params->empty_rect_allowed_, 1, quality,
-                  &params->rect_ll_, &params->sub_frame_ll_)) {
-    return 0;
+  if (!is_key_frame || is_first_frame) {  // Optimize frame rectangles.
+    // Note: This behaves as expected for first frame, as 'prev_canvas' is
+    // initialized to a fully transparent canvas in the beginning.
+    MinimizeChangeRectangles(prev_canvas, curr_canvas, &params->rect_ll_,
+                             &params->rect_lossy_, quality);
+  } else {
+    params->rect_lossy_ = params->rect_ll_;
   }
-  // Lossy frame rectangle.
-  params->rect_lossy_ = params->rect_ll_;  // seed with lossless rect.
-  return GetSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
-                    params->empty_rect_allowed_, 0, quality,
+  return GetSubRect(curr_canvas, params->empty_rect_allowed_,
+                    &params->rect_ll_, &params->sub_frame_ll_) &&
+         GetSubRect(curr_canvas, params->empty_rect_allowed_,
                     &params->rect_lossy_, &params->sub_frame_lossy_);
 }
 
@@ -595,7 +640,7 @@ int WebPAnimEncoderRefineRect(
     const WebPPicture* const prev_canvas, const WebPPicture* const curr_canvas,
     int is_lossless, float quality, int* const x_offset, int* const y_offset,
     int* const width, int* const height) {
-  FrameRectangle rect;
+  FrameRectangle rect, rect_lossy;
   const int right = clip(*x_offset + *width, 0, curr_canvas->width);
   const int left = clip(*x_offset, 0, curr_canvas->width - 1);
   const int bottom = clip(*y_offset + *height, 0, curr_canvas->height);
@@ -610,8 +655,9 @@ int WebPAnimEncoderRefineRect(
   rect.y_offset_ = top;
   rect.width_ = clip(right - left, 0, curr_canvas->width - rect.x_offset_);
   rect.height_ = clip(bottom - top, 0, curr_canvas->height - rect.y_offset_);
-  MinimizeChangeRectangle(prev_canvas, curr_canvas, &rect, is_lossless,
-                          quality);
+  MinimizeChangeRectangles(prev_canvas, curr_canvas, &rect, &rect_lossy,
+                           quality);
+  if (!is_lossless) rect = rect_lossy;
   SnapToEvenOffsets(&rect);
   *x_offset = rect.x_offset_;
   *y_offset = rect.y_offset_;
@@ -633,6 +679,40 @@ static uint32_t RectArea(const FrameRectangle* const rect) {
   return (uint32_t)rect->width_ * rect->height_;
 }
 
+// Grows 'dst' to the bounding box of 'dst' and 'rect'.
+static void RectUnion(const FrameRectangle* const rect,
+                      FrameRectangle* const dst) {
+  int right, bottom;
+  if (IsEmptyRect(rect)) return;
+  if (IsEmptyRect(dst)) {
+    *dst = *rect;
+    return;
+  }
+  right = rect->x_offset_ + rect->width_;
+  bottom = rect->y_offset_ + rect->height_;
+  if (right < dst->x_offset_ + dst->width_) right = dst->x_offset_ + dst->width_;
+  if (bottom < dst->y_offset_ + dst->height_) {
+    bottom = dst->y_offset_ + dst->height_;
+  }
+  if (dst->x_offset_ > rect->x_offset_) dst->x_offset_ = rect->x_offset_;
+  if (dst->y_offset_ > rect->y_offset_) dst->y_offset_ = rect->y_offset_;
+  dst->width_ = right - dst->x_offset_;
+  dst->height_ = bottom - dst->y_offset_;
+}
+
+// Copies the pixels in 'rect' from 'src' to 'dst'.
+static void CopyRectangle(const WebPPicture* const src,
+                          const FrameRectangle* const rect,
+                          WebPPicture* const dst) {
+  int j;
+  assert(src->width == dst->width && src->height == dst->height);
+  for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
+    memcpy(dst->argb + j * dst->argb_stride + rect->x_offset_,
+           src->argb + j * src->argb_stride + rect->x_offset_,
+           rect->width_ * sizeof(*dst->argb));
+  }
+}
+
 static int IsLosslessBlendingPossible(const WebPPicture* const src,
                                       const WebPPicture* const dst,
                                       const FrameRectangle* const rect) {
@@ -781,6 +861,7 @@ typedef struct {
   WebPMuxFrameInfo  info_;
   FrameRectangle    rect_;
   int               evaluate_;  // True if this candidate should be evaluated.
+  double            time_ms_;   // Encoding time, if the job is timed.
 } Candidate;
 
 // Generates a candidate encoded frame given a picture and metadata.
@@ -826,47 +907,184 @@ static WebPEncodingError EncodeCandidate(WebPPicture* const sub_frame,
   return error_code;
 }
 
-static void CopyCurrentCanvas(WebPAnimEncoder* const enc) {
-  if (enc->curr_canvas_copy_modified_) {
-    WebPCopyPixels(enc->curr_canvas_, &enc->curr_canvas_copy_);
-    enc->curr_canvas_copy_.progress_hook = enc->curr_canvas_->progress_hook;
-    enc->curr_canvas_copy_.user_data = enc->curr_canvas_->user_data;
-    enc->curr_canvas_copy_modified_ = 0;
+// Encoding job for one candidate. Each job works on its own copy of the
+// current canvas, so that the candidates can be encoded concurrently.
+typedef struct {
+  const WebPPicture* prev_canvas_;  // Canvas the candidate is blended onto.
+  const FrameRectangle* rect_;      // Frame rectangle of the candidate.
+  const WebPConfig* config_;        // Lossless or lossy encoding config.
+  int use_blending_;                // True if the candidate uses blending.
+  int timed_;                       // True if the encoding time is measured.
+  WebPPicture* canvas_;             // Private copy of the current canvas.
+  WebPPicture sub_frame_;           // View of 'rect_' in 'canvas_'.
+  WebPWorker* worker_;              // Worker the job can be run on.
+  Candidate* candidate_;            // Output; NULL if the job is unused.
+  WebPEncodingError error_code_;
+} CandidateJob;
+
+// Copies the frame rectangle of the current canvas to the private canvas of
+// candidate 'index' and sets up 'job' to encode it.
+static WebPEncodingError SetupCandidateJob(
+    WebPAnimEncoder* const enc, int is_key_frame, int index,
+    const WebPPicture* const prev_canvas, const FrameRectangle* const rect,
+    const WebPConfig* const config, int use_blending,
+    Candidate candidates[CANDIDATE_COUNT], CandidateJob* const job) {
+  const WebPPicture* const curr_canvas = enc->curr_canvas_;
+  WebPPicture* const canvas = &enc->candidate_canvas_[is_key_frame][index];
+  WebPPicture src;
+  int ok;
+
+  if (canvas->argb == NULL) {
+    canvas->width = enc->canvas_width_;
+    canvas->height = enc->canvas_height_;
+    canvas->use_argb = 1;
+    if (!WebPPictureAlloc(canvas)) return VP8_ENC_ERROR_OUT_OF_MEMORY;
+  }
+  canvas->progress_hook = curr_canvas->progress_hook;
+  canvas->user_data = curr_canvas->user_data;
+  // Lossless candidates keep the encoder's scratch memory from one frame to
+  // the next. The view set up below shares the cache of the canvas.
+  if (config->lossless && canvas->lossless_cache == NULL) {
+    canvas->lossless_cache = WebPLosslessCacheNew();
+    if (canvas->lossless_cache == NULL) return VP8_ENC_ERROR_OUT_OF_MEMORY;
+  }
+
+  job->prev_canvas_ = prev_canvas;
+  job->rect_ = rect;
+  job->config_ = config;
+  job->use_blending_ = use_blending;
+  job->timed_ = enc->options_.frame_stats;
+  job->canvas_ = canvas;
+  job->worker_ = &enc->candidate_workers_[is_key_frame][index];
+  job->candidate_ = &candidates[index];
+  job->error_code_ = VP8_ENC_OK;
+
+  // Only the pixels inside the frame rectangle are read by the encoder.
+  WebPPictureInit(&src);
+  ok = WebPPictureView(curr_canvas, rect->x_offset_, rect->y_offset_,
+                       rect->width_, rect->height_, &src) &&
+       WebPPictureView(canvas, rect->x_offset_, rect->y_offset_,
+                       rect->width_, rect->height_, &job->sub_frame_);
+  if (!ok) return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+  WebPCopyPixels(&src, &job->sub_frame_);
+  return VP8_ENC_OK;
+}
+
+// Wall-clock time in milliseconds, for the frame statistics.
+static double GetTimeMs(void) {
+#if defined(_WIN32)
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return 1000. * count.QuadPart / frequency.QuadPart;
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return 1000. * now.tv_sec + now.tv_usec / 1000.;
+#endif
+}
+
+static int CandidateJobHook(void* arg1, void* arg2) {
+  CandidateJob* const job = (CandidateJob*)arg1;
+  const double start = job->timed_ ? GetTimeMs() : 0.;
+  (void)arg2;
+  if (job->use_blending_) {
+    if (job->config_->lossless) {
+      IncreaseTransparency(job->prev_canvas_, job->rect_, job->canvas_);
+    } else {
+      FlattenSimilarBlocks(job->prev_canvas_, job->rect_, job->canvas_,
+                           job->config_->quality);
+    }
   }
+  job->error_code_ = EncodeCandidate(&job->sub_frame_, job->rect_,
+                                     job->config_, job->use_blending_,
+                                     job->candidate_);
+  if (job->timed_) job->candidate_->time_ms_ = GetTimeMs() - start;
+  return (job->error_code_ == VP8_ENC_OK);
 }
 
+#define MIN_COLORS_LOSSY     31  // Don't try lossy below this threshold.
+#define MAX_COLORS_LOSSLESS 194  // Don't try lossless above this threshold.
+
 enum {
-  LL_DISP_NONE = 0,
-  LL_DISP_BG,
-  LOSSY_DISP_NONE,
-  LOSSY_DISP_BG,
-  CANDIDATE_COUNT
+  PREDICT_UNUSED = -2,  // Palette size alone decided.
+  PREDICT_NONE = -1,    // No clear winner, try both.
+  PREDICT_LOSSY = 0,
+  PREDICT_LOSSLESS = 1
 };
 
-#define MIN_COLORS_LOSSY     31  // Don't try lossy below this threshold.
-#define MAX_COLORS_LOSSLESS 194  // Don't try lossless above this threshold.
+// Thresholds for PredictCompression(), tuned on rendered lottie animations.
+#define PREDICT_MIN_FLAT_LOSSLESS  0.98  // Fraction of unchanged neighbours.
+#define PREDICT_MAX_BITS_LOSSLESS  1.5   // Residual entropy, bits per pixel.
+
+// Predicts from the content of 'sub_frame' whether lossless or lossy
+// compression gives the smaller frame, for frames whose palette size doesn't
+// decide it. Large flat fills with few distinct left-predictor residuals
+// reliably favour lossless. Nothing measured here picks lossy reliably
+// enough, so the other frames are left to trying both.
+static int PredictCompression(const WebPPicture* const sub_frame) {
+  uint32_t histo[4][256];
+  int flat = 0, count = 0;
+  double bits = 0.;
+  int x, y, c;
+  memset(histo, 0, sizeof(histo));
+  for (y = 0; y < sub_frame->height; ++y) {
+    const uint32_t* const row = sub_frame->argb + y * sub_frame->argb_stride;
+    for (x = 1; x < sub_frame->width; ++x) {
+      const uint32_t left = row[x - 1], pixel = row[x];
+      // Residuals of the left predictor after subtracting green, roughly
+      // what the lossless encoder codes.
+      const int green = (pixel >> 8) & 0xff, left_green = (left >> 8) & 0xff;
+      for (c = 0; c < 4; ++c) {
+        const int shift = 8 * c;
+        const int v = (pixel >> shift) & 0xff, l = (left >> shift) & 0xff;
+        const int residual = (c == 0 || c == 2)
+                                 ? (v - green) - (l - left_green)
+                                 : v - l;
+        ++histo[c][residual & 0xff];
+      }
+      if (pixel == left) ++flat;
+      ++count;
+    }
+  }
+  if (count == 0) return PREDICT_NONE;
+  if (flat < PREDICT_MIN_FLAT_LOSSLESS * count) return PREDICT_NONE;
+  for (c = 0; c < 4; ++c) {
+    int i;
+    for (i = 0; i < 256; ++i) {
+      if (histo[c][i] != 0) {
+        const double p = (double)histo[c][i] / count;
+        bits -= p * log(p);
+      }
+    }
+  }
+  bits /= log(2.);
+  return (bits < PREDICT_MAX_BITS_LOSSLESS) ? PREDICT_LOSSLESS : PREDICT_NONE;
+}
 
-// Generates candidates for a given dispose method given pre-filled sub-frame
-// 'params'.
+#undef PREDICT_MIN_FLAT_LOSSLESS
+#undef PREDICT_MAX_BITS_LOSSLESS
+
+// Sets up the candidate jobs for a given dispose method given pre-filled
+// sub-frame 'params'. The candidates are encoded by RunCandidateJobs().
 static WebPEncodingError GenerateCandidates(
     WebPAnimEncoder* const enc, Candidate candidates[CANDIDATE_COUNT],
+    CandidateJob jobs[CANDIDATE_COUNT],
     WebPMuxAnimDispose dispose_method, int is_lossless, int is_key_frame,
     SubFrameParams* const params,
-    const WebPConfig* const config_ll, const WebPConfig* const config_lossy) {
+    const WebPConfig* const config_ll, const WebPConfig* const config_lossy,
+    int* const prediction) {
   WebPEncodingError error_code = VP8_ENC_OK;
   const int is_dispose_none = (dispose_method == WEBP_MUX_DISPOSE_NONE);
-  Candidate* const candidate_ll =
-      is_dispose_none ? &candidates[LL_DISP_NONE] : &candidates[LL_DISP_BG];
-  Candidate* const candidate_lossy = is_dispose_none
-                                     ? &candidates[LOSSY_DISP_NONE]
-                                     : &candidates[LOSSY_DISP_BG];
-  WebPPicture* const curr_canvas = &enc->curr_canvas_copy_;
+  const int index_ll = is_dispose_none ? LL_DISP_NONE : LL_DISP_BG;
+  const int index_lossy = is_dispose_none ? LOSSY_DISP_NONE : LOSSY_DISP_BG;
+  const WebPPicture* const curr_canvas = enc->curr_canvas_;
   const WebPPicture* const prev_canvas =
       is_dispose_none ? &enc->prev_canvas_ : &enc->prev_canvas_disposed_;
   int use_blending_ll, use_blending_lossy;
   int evaluate_ll, evaluate_lossy;
 
-  CopyCurrentCanvas(enc);
+  *prediction = PREDICT_UNUSED;
   use_blending_ll =
       !is_key_frame &&
       IsLosslessBlendingPossible(prev_canvas, curr_canvas, &params->rect_ll_);
@@ -886,31 +1104,31 @@ static WebPEncodingError GenerateCandidates(
     const int num_colors = WebPGetColorPalette(&params->sub_frame_ll_, NULL);
     evaluate_ll = (num_colors < MAX_COLORS_LOSSLESS);
     evaluate_lossy = (num_colors >= MIN_COLORS_LOSSY);
+    if (evaluate_ll && evaluate_lossy) {
+      *prediction = PredictCompression(&params->sub_frame_ll_);
+      if (enc->options_.mixed_predictor == 1 &&
+          *prediction != PREDICT_NONE) {
+        evaluate_ll = (*prediction == PREDICT_LOSSLESS);
+        evaluate_lossy = !evaluate_ll;
+      }
+    }
   }
 
   // Generate candidates.
   if (evaluate_ll) {
-    CopyCurrentCanvas(enc);
-    if (use_blending_ll) {
-      enc->curr_canvas_copy_modified_ =
-          IncreaseTransparency(prev_canvas, &params->rect_ll_, curr_canvas);
-    }
-    error_code = EncodeCandidate(&params->sub_frame_ll_, &params->rect_ll_,
-                                 config_ll, use_blending_ll, candidate_ll);
+    error_code = SetupCandidateJob(enc, is_key_frame, index_ll, prev_canvas,
+                                   &params->rect_ll_, config_ll,
+                                   use_blending_ll, candidates,
+                                   &jobs[index_ll]);
     if (error_code != VP8_ENC_OK) return error_code;
   }
   if (evaluate_lossy) {
-    CopyCurrentCanvas(enc);
-    if (use_blending_lossy) {
-      enc->curr_canvas_copy_modified_ =
-          FlattenSimilarBlocks(prev_canvas, &params->rect_lossy_, curr_canvas,
-                               config_lossy->quality);
-    }
-    error_code =
-        EncodeCandidate(&params->sub_frame_lossy_, &params->rect_lossy_,
-                        config_lossy, use_blending_lossy, candidate_lossy);
+    error_code = SetupCandidateJob(enc, is_key_frame, index_lossy,
+                                   prev_canvas,
+                                   &params->rect_lossy_, config_lossy,
+                                   use_blending_lossy, candidates,
+                                   &jobs[index_lossy]);
     if (error_code != VP8_ENC_OK) return error_code;
-    enc->curr_canvas_copy_modified_ = 1;
   }
   return error_code;
 }
@@ -1032,6 +1250,7 @@ static void PickBestCandidate(WebPAnimEncoder* const enc,
                                       : &encoded_frame->sub_frame_;
         *dst = candidates[i].info_;
         GetEncodedData(&candidates[i].mem_, &dst->bitstream);
+        encoded_frame->candidate_[is_key_frame] = best_idx;
         if (!is_key_frame) {
           // Note: Previous dispose method only matters for non-keyframes.
           // Also, we don't want to modify previous dispose method that was
@@ -1051,20 +1270,117 @@ static void PickBestCandidate(WebPAnimEncoder* const enc,
   }
 }
 
-// Depending on the configuration, tries different compressions
-// (lossy/lossless), dispose methods, blending methods etc to encode the current
-// frame and outputs the best one in 'encoded_frame'.
-// 'frame_skipped' will be set to true if this frame should actually be skipped.
-static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
-                                  const WebPConfig* const config,
-                                  int is_key_frame,
-                                  EncodedFrame* const encoded_frame,
-                                  int* const frame_skipped) {
+// Candidates of the current frame encoded either as a sub-frame or as a
+// key-frame, from the time their jobs are set up until the best one is picked.
+typedef struct {
+  WebPConfig config_ll_;
+  WebPConfig config_lossy_;
+  SubFrameParams dispose_none_params_;
+  SubFrameParams dispose_bg_params_;
+  Candidate candidates_[CANDIDATE_COUNT];
+  CandidateJob jobs_[CANDIDATE_COUNT];
+  int prediction_[2];  // PredictCompression() result per dispose method.
+} FrameCandidates;
+
+// Releases 'frame'. Unless 'picked' is true, the encoded candidates are
+// released too.
+static void FrameCandidatesFree(FrameCandidates* const frame, int picked) {
   int i;
+  for (i = 0; i < CANDIDATE_COUNT; ++i) {
+    if (!picked && frame->candidates_[i].evaluate_) {
+      WebPMemoryWriterClear(&frame->candidates_[i].mem_);
+    }
+    if (frame->jobs_[i].candidate_ != NULL) {
+      WebPPictureFree(&frame->jobs_[i].sub_frame_);
+    }
+  }
+  SubFrameParamsFree(&frame->dispose_none_params_);
+  SubFrameParamsFree(&frame->dispose_bg_params_);
+}
+
+// Memory held by an ARGB canvas.
+static size_t CanvasBytes(const WebPPicture* const canvas) {
+  if (canvas->memory_argb_ == NULL) return 0;
+  return (size_t)canvas->argb_stride * canvas->height * sizeof(uint32_t);
+}
+
+static void GetMemory(const WebPAnimEncoder* const enc,
+                      WebPAnimEncoderMemory* const memory) {
+  size_t i;
+  int k, c;
+  memory->canvases = CanvasBytes(&enc->curr_canvas_copy_) +
+                     CanvasBytes(&enc->prev_canvas_) +
+                     CanvasBytes(&enc->prev_canvas_disposed_);
+  for (k = 0; k < 2; ++k) {
+    for (c = 0; c < CANDIDATE_COUNT; ++c) {
+      memory->canvases += CanvasBytes(&enc->candidate_canvas_[k][c]);
+    }
+  }
+  memory->frames = enc->size_ * sizeof(*enc->encoded_frames_) +
+                   enc->reused_frames_size_ * sizeof(*enc->reused_frames_) +
+                   enc->frame_stats_size_ * sizeof(*enc->frame_stats_);
+  for (i = 0; i < enc->count_; ++i) {
+    const EncodedFrame* const frame = GetFrame(enc, i);
+    memory->frames += frame->sub_frame_.bitstream.size +
+                      frame->key_frame_.bitstream.size;
+  }
+  for (k = 0; k < enc->num_reused_frames_; ++k) {
+    memory->frames += enc->reused_frames_[k].sub_frame_.bitstream.size;
+  }
+  memory->candidates = enc->candidate_bytes_;
+  memory->mux = enc->mux_bytes_;
+  memory->peak = enc->peak_bytes_;
+}
+
+// Raises the peak memory to what 'enc' holds plus 'transient_bytes' if that
+// is higher.
+static void UpdatePeakMemory(WebPAnimEncoder* const enc,
+                             size_t transient_bytes) {
+  WebPAnimEncoderMemory memory;
+  size_t total;
+  GetMemory(enc, &memory);
+  total = memory.canvases + memory.frames + memory.mux + transient_bytes;
+  if (total > enc->peak_bytes_) enc->peak_bytes_ = total;
+}
+
+// Accounts for the encoded candidates of 'frames', before the best ones are
+// picked and the others released.
+static void UpdateCandidateMemory(WebPAnimEncoder* const enc,
+                                  FrameCandidates* const frames[],
+                                  int num_frames) {
+  size_t bytes = 0;
+  int f, i;
+  for (f = 0; f < num_frames; ++f) {
+    for (i = 0; i < CANDIDATE_COUNT; ++i) {
+      const Candidate* const candidate = &frames[f]->candidates_[i];
+      if (candidate->evaluate_) bytes += candidate->mem_.max_size;
+    }
+  }
+  if (bytes > enc->candidate_bytes_) enc->candidate_bytes_ = bytes;
+  UpdatePeakMemory(enc, bytes);
+}
+
+// Saves 'config' in case a re-encode is needed.
+static void SetLastConfig(WebPAnimEncoder* const enc,
+                          const WebPConfig* const config) {
+  enc->last_config_ = *config;
+  enc->last_config_reversed_ = *config;
+  enc->last_config_reversed_.lossless = !config->lossless;
+}
+
+// Depending on the configuration, sets up the candidates with different
+// compressions (lossy/lossless), dispose methods, blending methods etc to
+// encode the current frame. The candidates are encoded by RunCandidateJobs().
+// 'frame_skipped' will be set to true if this frame should actually be skipped.
+// 'frame' must be released with FrameCandidatesFree(), even on error.
+static WebPEncodingError SetupFrame(WebPAnimEncoder* const enc,
+                                    const WebPConfig* const config,
+                                    int is_key_frame,
+                                    FrameCandidates* const frame,
+                                    int* const frame_skipped) {
   WebPEncodingError error_code = VP8_ENC_OK;
-  const WebPPicture* const curr_canvas = &enc->curr_canvas_copy_;
+  const WebPPicture* const curr_canvas = enc->curr_canvas_;
   const WebPPicture* const prev_canvas = &enc->prev_canvas_;
-  Candidate candidates[CANDIDATE_COUNT];
   const int is_lossless = config->lossless;
   const int consider_lossless = is_lossless || enc->options_.allow_mixed;
   const int consider_lossy = !is_lossless || enc->options_.allow_mixed;
@@ -1089,100 +1405,257 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
   const int dispose_bg_possible =
       !is_key_frame && !enc->prev_candidate_undecided_;
 
-  SubFrameParams dispose_none_params;
-  SubFrameParams dispose_bg_params;
-
-  WebPConfig config_ll = *config;
-  WebPConfig config_lossy = *config;
-  config_ll.lossless = 1;
-  config_lossy.lossless = 0;
-  enc->last_config_ = *config;
-  enc->last_config_reversed_ = config->lossless ? config_lossy : config_ll;
+  SubFrameParams* const dispose_none_params = &frame->dispose_none_params_;
+  SubFrameParams* const dispose_bg_params = &frame->dispose_bg_params_;
+  WebPConfig* const config_ll = &frame->config_ll_;
+  WebPConfig* const config_lossy = &frame->config_lossy_;
+
+  memset(frame, 0, sizeof(*frame));
+  frame->prediction_[0] = frame->prediction_[1] = PREDICT_UNUSED;
+  *config_ll = *config;
+  *config_lossy = *config;
+  config_ll->lossless = 1;
+  config_lossy->lossless = 0;
+  SetLastConfig(enc, config);
   *frame_skipped = 0;
 
-  if (!SubFrameParamsInit(&dispose_none_params, 1, empty_rect_allowed_none) ||
-      !SubFrameParamsInit(&dispose_bg_params, 0, empty_rect_allowed_bg)) {
+  if (!SubFrameParamsInit(dispose_none_params, 1, empty_rect_allowed_none) ||
+      !SubFrameParamsInit(dispose_bg_params, 0, empty_rect_allowed_bg)) {
     return VP8_ENC_ERROR_INVALID_CONFIGURATION;
   }
 
-  memset(candidates, 0, sizeof(candidates));
-
   // Change-rectangle assuming previous frame was DISPOSE_NONE.
   if (!GetSubRects(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
-                   config_lossy.quality, &dispose_none_params)) {
-    error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
-    goto Err;
+                   config_lossy->quality, dispose_none_params)) {
+    return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+  }
+  if (!is_key_frame || is_first_frame) {
+    // The lossless rectangle was minimized, so it holds all changed pixels.
+    // A key-frame is always set up after the sub-frame of the same frame.
+    enc->changed_rect_ = dispose_none_params->rect_ll_;
   }
 
-  if ((consider_lossless && IsEmptyRect(&dispose_none_params.rect_ll_)) ||
-      (consider_lossy && IsEmptyRect(&dispose_none_params.rect_lossy_))) {
+  if ((consider_lossless && IsEmptyRect(&dispose_none_params->rect_ll_)) ||
+      (consider_lossy && IsEmptyRect(&dispose_none_params->rect_lossy_))) {
     // Don't encode the frame at all. Instead, the duration of the previous
     // frame will be increased later.
     assert(empty_rect_allowed_none);
     *frame_skipped = 1;
-    goto End;
+    return VP8_ENC_OK;
   }
 
   if (dispose_bg_possible) {
     // Change-rectangle assuming previous frame was DISPOSE_BACKGROUND.
+    // Only the pixels that may differ from 'prev_canvas' are refreshed.
     WebPPicture* const prev_canvas_disposed = &enc->prev_canvas_disposed_;
-    WebPCopyPixels(prev_canvas, prev_canvas_disposed);
+    CopyRectangle(prev_canvas, &enc->disposed_dirty_rect_,
+                  prev_canvas_disposed);
     DisposeFrameRectangle(WEBP_MUX_DISPOSE_BACKGROUND, &enc->prev_rect_,
                           prev_canvas_disposed);
+    enc->disposed_dirty_rect_ = enc->prev_rect_;
 
     if (!GetSubRects(prev_canvas_disposed, curr_canvas, is_key_frame,
-                     is_first_frame, config_lossy.quality,
-                     &dispose_bg_params)) {
-      error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
-      goto Err;
+                     is_first_frame, config_lossy->quality,
+                     dispose_bg_params)) {
+      return VP8_ENC_ERROR_INVALID_CONFIGURATION;
     }
-    assert(!IsEmptyRect(&dispose_bg_params.rect_ll_));
-    assert(!IsEmptyRect(&dispose_bg_params.rect_lossy_));
+    assert(!IsEmptyRect(&dispose_bg_params->rect_ll_));
+    assert(!IsEmptyRect(&dispose_bg_params->rect_lossy_));
 
     if (enc->options_.minimize_size) {  // Try both dispose methods.
-      dispose_bg_params.should_try_ = 1;
-      dispose_none_params.should_try_ = 1;
+      dispose_bg_params->should_try_ = 1;
+      dispose_none_params->should_try_ = 1;
     } else if ((is_lossless &&
-                RectArea(&dispose_bg_params.rect_ll_) <
-                    RectArea(&dispose_none_params.rect_ll_)) ||
+                RectArea(&dispose_bg_params->rect_ll_) <
+                    RectArea(&dispose_none_params->rect_ll_)) ||
                (!is_lossless &&
-                RectArea(&dispose_bg_params.rect_lossy_) <
-                    RectArea(&dispose_none_params.rect_lossy_))) {
-      dispose_bg_params.should_try_ = 1;  // Pick DISPOSE_BACKGROUND.
-      dispose_none_params.should_try_ = 0;
+                RectArea(&dispose_bg_params->rect_lossy_) <
+                    RectArea(&dispose_none_params->rect_lossy_))) {
+      dispose_bg_params->should_try_ = 1;  // Pick DISPOSE_BACKGROUND.
+      dispose_none_params->should_try_ = 0;
     }
   }
 
-  if (dispose_none_params.should_try_) {
+  if (dispose_none_params->should_try_) {
     error_code = GenerateCandidates(
-        enc, candidates, WEBP_MUX_DISPOSE_NONE, is_lossless, is_key_frame,
-        &dispose_none_params, &config_ll, &config_lossy);
-    if (error_code != VP8_ENC_OK) goto Err;
+        enc, frame->candidates_, frame->jobs_, WEBP_MUX_DISPOSE_NONE,
+        is_lossless, is_key_frame, dispose_none_params, config_ll,
+        config_lossy, &frame->prediction_[0]);
+    if (error_code != VP8_ENC_OK) return error_code;
   }
 
-  if (dispose_bg_params.should_try_) {
+  if (dispose_bg_params->should_try_) {
     assert(!enc->is_first_frame_);
     assert(dispose_bg_possible);
     error_code = GenerateCandidates(
-        enc, candidates, WEBP_MUX_DISPOSE_BACKGROUND, is_lossless, is_key_frame,
-        &dispose_bg_params, &config_ll, &config_lossy);
-    if (error_code != VP8_ENC_OK) goto Err;
+        enc, frame->candidates_, frame->jobs_, WEBP_MUX_DISPOSE_BACKGROUND,
+        is_lossless, is_key_frame, dispose_bg_params, config_ll,
+        config_lossy, &frame->prediction_[1]);
   }
+  return error_code;
+}
+
+// Encodes the candidates set up for the 'num_frames' entries of 'frames'.
+// With multi-threading, all but the last candidate are encoded on worker
+// threads.
+static WebPEncodingError RunCandidateJobs(FrameCandidates* const frames[],
+                                          int num_frames, int use_threads) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  CandidateJob* jobs[2 * CANDIDATE_COUNT];
+  WebPEncodingError error_code = VP8_ENC_OK;
+  int i, j, num_jobs = 0;
 
-  PickBestCandidate(enc, candidates, is_key_frame, encoded_frame);
+  assert(num_frames <= 2);
+  for (i = 0; i < num_frames; ++i) {
+    for (j = 0; j < CANDIDATE_COUNT; ++j) {
+      if (frames[i]->jobs_[j].candidate_ != NULL) {
+        jobs[num_jobs++] = &frames[i]->jobs_[j];
+      }
+    }
+  }
+  for (i = 0; i < num_jobs; ++i) {
+    WebPWorker* const worker = jobs[i]->worker_;
+    worker->hook = CandidateJobHook;
+    worker->data1 = jobs[i];
+    worker->data2 = NULL;
+    if (use_threads && i != num_jobs - 1 && winterface->Reset(worker)) {
+      winterface->Launch(worker);
+    } else {
+      worker->had_error = 0;
+      winterface->Execute(worker);
+    }
+  }
+  for (i = 0; i < num_jobs; ++i) {
+    winterface->Sync(jobs[i]->worker_);
+    // Report the first error in candidate order.
+    if (error_code == VP8_ENC_OK) error_code = jobs[i]->error_code_;
+  }
+  return error_code;
+}
 
-  goto End;
+// When benchmarking the predictor, compares its predictions with the smaller
+// of the lossless and lossy candidates. Must be called before the candidates
+// are picked.
+static void UpdatePredictionStats(WebPAnimEncoder* const enc,
+                                  const FrameCandidates* const frame) {
+  int i;
+  if (enc->options_.mixed_predictor != 2) return;
+  for (i = 0; i < 2; ++i) {
+    const int prediction = frame->prediction_[i];
+    const Candidate* const ll =
+        &frame->candidates_[(i == 0) ? LL_DISP_NONE : LL_DISP_BG];
+    const Candidate* const lossy =
+        &frame->candidates_[(i == 0) ? LOSSY_DISP_NONE : LOSSY_DISP_BG];
+    size_t ll_size, lossy_size;
+    if (prediction == PREDICT_UNUSED) continue;
+    assert(ll->evaluate_ && lossy->evaluate_);
+    ll_size = ll->mem_.size;
+    lossy_size = lossy->mem_.size;
+    if (prediction == PREDICT_NONE) {
+      ++enc->num_undecided_;
+    } else {
+      const size_t predicted_size =
+          (prediction == PREDICT_LOSSLESS) ? ll_size : lossy_size;
+      const size_t best_size = (ll_size <= lossy_size) ? ll_size : lossy_size;
+      ++enc->num_predicted_;
+      if (predicted_size == best_size) ++enc->num_correct_;
+      enc->lost_bytes_ += (int64_t)(predicted_size - best_size);
+    }
+  }
+}
 
- Err:
+// Records the size and encoding time of the candidates in the statistics of
+// the current frame. Must be called before the candidates are picked.
+static void UpdateCandidateStats(WebPAnimEncoder* const enc,
+                                 const FrameCandidates* const frame,
+                                 int is_key_frame) {
+  WebPAnimCandidateStats* const stats =
+      is_key_frame ? enc->curr_stats_->key_frame_candidates
+                   : enc->curr_stats_->sub_frame_candidates;
+  int i;
   for (i = 0; i < CANDIDATE_COUNT; ++i) {
-    if (candidates[i].evaluate_) {
-      WebPMemoryWriterClear(&candidates[i].mem_);
+    const Candidate* const candidate = &frame->candidates_[i];
+    if (candidate->evaluate_) {
+      stats[i].size = candidate->mem_.size;
+      stats[i].time_ms = candidate->time_ms_;
     }
   }
+}
+
+// Encodes the current frame as a sub-frame or as a key-frame and outputs the
+// best candidate in 'encoded_frame'.
+// 'frame_skipped' will be set to true if this frame should actually be skipped.
+static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
+                                  const WebPConfig* const config,
+                                  int is_key_frame,
+                                  EncodedFrame* const encoded_frame,
+                                  int* const frame_skipped) {
+  FrameCandidates frame;
+  FrameCandidates* frames[1];
+  int picked = 0;
+  WebPEncodingError error_code =
+      SetupFrame(enc, config, is_key_frame, &frame, frame_skipped);
+  if (error_code != VP8_ENC_OK || *frame_skipped) goto End;
+
+  frames[0] = &frame;
+  error_code = RunCandidateJobs(frames, 1, config->thread_level > 0);
+  if (error_code != VP8_ENC_OK) goto End;
+  UpdateCandidateMemory(enc, frames, 1);
+  UpdatePredictionStats(enc, &frame);
+  if (enc->curr_stats_ != NULL) {
+    UpdateCandidateStats(enc, &frame, is_key_frame);
+  }
+
+  PickBestCandidate(enc, frame.candidates_, is_key_frame, encoded_frame);
+  picked = 1;
 
  End:
-  SubFrameParamsFree(&dispose_none_params);
-  SubFrameParamsFree(&dispose_bg_params);
+  FrameCandidatesFree(&frame, picked);
+  return error_code;
+}
+
+// Encodes the current frame both as a sub-frame and as a key-frame, with the
+// candidates of both encoded together. The frame rectangles picked for each
+// are returned in 'rect_sub' and 'rect_key'.
+// 'frame_skipped' will be set to true if this frame should actually be skipped.
+static WebPEncodingError SetSubFrameAndKeyFrame(
+    WebPAnimEncoder* const enc, const WebPConfig* const config,
+    EncodedFrame* const encoded_frame, int* const frame_skipped,
+    FrameRectangle* const rect_sub, FrameRectangle* const rect_key) {
+  FrameCandidates sub_frame, key_frame;
+  FrameCandidates* frames[2];
+  int key_frame_skipped = 0;
+  int picked = 0;
+  WebPEncodingError error_code;
+
+  memset(&key_frame, 0, sizeof(key_frame));
+  error_code = SetupFrame(enc, config, 0, &sub_frame, frame_skipped);
+  if (error_code != VP8_ENC_OK || *frame_skipped) goto End;
+  error_code = SetupFrame(enc, config, 1, &key_frame, &key_frame_skipped);
+  if (error_code != VP8_ENC_OK) goto End;
+  assert(key_frame_skipped == 0);  // Key-frame cannot be an empty rectangle.
+
+  frames[0] = &sub_frame;
+  frames[1] = &key_frame;
+  error_code = RunCandidateJobs(frames, 2, config->thread_level > 0);
+  if (error_code != VP8_ENC_OK) goto End;
+  UpdateCandidateMemory(enc, frames, 2);
+  UpdatePredictionStats(enc, &sub_frame);
+  UpdatePredictionStats(enc, &key_frame);
+  if (enc->curr_stats_ != NULL) {
+    UpdateCandidateStats(enc, &sub_frame, 0);
+    UpdateCandidateStats(enc, &key_frame, 1);
+  }
+
+  PickBestCandidate(enc, sub_frame.candidates_, 0, encoded_frame);
+  *rect_sub = enc->prev_rect_;
+  PickBestCandidate(enc, key_frame.candidates_, 1, encoded_frame);
+  *rect_key = enc->prev_rect_;
+  picked = 1;
+
+ End:
+  FrameCandidatesFree(&sub_frame, picked);
+  FrameCandidatesFree(&key_frame, picked);
   return error_code;
 }
 
@@ -1193,6 +1666,138 @@ static int64_t KeyFramePenalty(const EncodedFrame* const encoded_frame) {
           encoded_frame->sub_frame_.bitstream.size);
 }
 
+// -----------------------------------------------------------------------------
+// Reuse of encoded sub-frames.
+
+#define MAX_REUSED_FRAMES 1024
+
+#define HASH_PRIME_1 0x9e3779b185ebca87ULL
+#define HASH_PRIME_2 0xc2b2ae3d27d4eb4fULL
+#define HASH_PRIME_3 0x165667b19e3779f9ULL
+
+static WEBP_INLINE uint64_t HashRound(uint64_t acc, uint64_t input) {
+  acc += input * HASH_PRIME_2;
+  acc = (acc << 31) | (acc >> 33);
+  return acc * HASH_PRIME_1;
+}
+
+// Returns a 64-bit hash of the pixels of 'picture', computed like xxHash64
+// rounds over pairs of pixels.
+static uint64_t HashCanvas(const WebPPicture* const picture) {
+  uint64_t hash = HASH_PRIME_3;
+  int x, y;
+  for (y = 0; y < picture->height; ++y) {
+    const uint32_t* const row = picture->argb + y * picture->argb_stride;
+    for (x = 0; x + 1 < picture->width; x += 2) {
+      hash = HashRound(hash, ((uint64_t)row[x + 1] << 32) | row[x]);
+    }
+    if (x < picture->width) hash = HashRound(hash, row[x]);
+  }
+  hash ^= hash >> 33;
+  hash *= HASH_PRIME_2;
+  hash ^= hash >> 29;
+  hash *= HASH_PRIME_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+#undef HASH_PRIME_1
+#undef HASH_PRIME_2
+#undef HASH_PRIME_3
+
+// Returns a frame kept earlier for the current canvas that was encoded in the
+// same encoder state, so that encoding the current frame would give the same
+// result, or NULL.
+static const ReusedFrame* FindReusedFrame(const WebPAnimEncoder* const enc,
+                                          const WebPConfig* const config) {
+  const int dispose_bg_possible = !enc->prev_candidate_undecided_;
+  int i;
+  // A frame equal to the previous one is skipped instead.
+  if (enc->curr_hash_ == enc->prev_hash_) return NULL;
+  for (i = 0; i < enc->num_reused_frames_; ++i) {
+    const ReusedFrame* const frame = &enc->reused_frames_[i];
+    if (frame->curr_hash_ == enc->curr_hash_ &&
+        frame->prev_hash_ == enc->prev_hash_ &&
+        !memcmp(&frame->config_, config, sizeof(*config)) &&
+        frame->dispose_bg_possible_ == dispose_bg_possible &&
+        (!dispose_bg_possible ||
+         !memcmp(&frame->prev_rect_, &enc->prev_rect_,
+                 sizeof(enc->prev_rect_)))) {
+      return frame;
+    }
+  }
+  return NULL;
+}
+
+// Keeps the sub-frame just encoded for the current canvas, if there is room.
+// 'prev_rect' and 'dispose_bg_possible' describe the encoder state it was
+// encoded in, and 'info' is the encoded frame.
+static int KeepReusedFrame(WebPAnimEncoder* const enc,
+                           const WebPConfig* const config,
+                           const FrameRectangle* const prev_rect,
+                           int dispose_bg_possible,
+                           const WebPMuxFrameInfo* const info) {
+  const EncodedFrame* const prev_enc_frame = GetFrame(enc, enc->count_ - 2);
+  ReusedFrame* frame;
+  assert(enc->count_ >= 2);
+  if (enc->num_reused_frames_ == MAX_REUSED_FRAMES) return 1;
+  if (enc->num_reused_frames_ == enc->reused_frames_size_) {
+    const int new_size =
+        (enc->reused_frames_size_ == 0) ? 16 : 2 * enc->reused_frames_size_;
+    ReusedFrame* const new_frames =
+        (ReusedFrame*)WebPSafeMalloc(new_size, sizeof(*new_frames));
+    if (new_frames == NULL) return 0;
+    if (enc->num_reused_frames_ > 0) {
+      memcpy(new_frames, enc->reused_frames_,
+             enc->num_reused_frames_ * sizeof(*new_frames));
+    }
+    WebPSafeFree(enc->reused_frames_);
+    enc->reused_frames_ = new_frames;
+    enc->reused_frames_size_ = new_size;
+  }
+  frame = &enc->reused_frames_[enc->num_reused_frames_];
+  memset(frame, 0, sizeof(*frame));
+  frame->prev_hash_ = enc->prev_hash_;
+  frame->curr_hash_ = enc->curr_hash_;
+  frame->prev_rect_ = *prev_rect;
+  frame->dispose_bg_possible_ = dispose_bg_possible;
+  frame->config_ = *config;
+  frame->sub_frame_ = *info;
+  WebPDataInit(&frame->sub_frame_.bitstream);
+  if (!WebPDataCopy(&info->bitstream, &frame->sub_frame_.bitstream)) {
+    return 0;
+  }
+  frame->rect_ = enc->prev_rect_;
+  frame->changed_rect_ = enc->changed_rect_;
+  frame->prev_dispose_ = prev_enc_frame->is_key_frame_
+                             ? prev_enc_frame->key_frame_.dispose_method
+                             : prev_enc_frame->sub_frame_.dispose_method;
+  ++enc->num_reused_frames_;
+  return 1;
+}
+
+// Outputs the frame kept in 'frame' as the current sub-frame.
+static int ReuseFrame(WebPAnimEncoder* const enc,
+                      const WebPConfig* const config,
+                      const ReusedFrame* const frame,
+                      EncodedFrame* const encoded_frame) {
+  encoded_frame->sub_frame_ = frame->sub_frame_;
+  WebPDataInit(&encoded_frame->sub_frame_.bitstream);
+  if (!WebPDataCopy(&frame->sub_frame_.bitstream,
+                    &encoded_frame->sub_frame_.bitstream)) {
+    return 0;
+  }
+  SetPreviousDisposeMethod(enc, frame->prev_dispose_);
+  SetLastConfig(enc, config);
+  enc->prev_rect_ = frame->rect_;
+  enc->changed_rect_ = frame->changed_rect_;
+  encoded_frame->candidate_[0] = -1;
+  if (enc->curr_stats_ != NULL) enc->curr_stats_->reused = 1;
+  return 1;
+}
+
+#undef MAX_REUSED_FRAMES
+
 static int CacheFrame(WebPAnimEncoder* const enc,
                       const WebPConfig* const config) {
   int ok = 0;
@@ -1202,6 +1807,12 @@ static int CacheFrame(WebPAnimEncoder* const enc,
   EncodedFrame* const encoded_frame = GetFrame(enc, position);
 
   ++enc->count_;
+  if (enc->options_.reuse_frames) {
+    enc->curr_hash_ = HashCanvas(enc->curr_canvas_);
+  }
+  if (enc->curr_stats_ != NULL) {
+    encoded_frame->stats_index_ = (size_t)enc->num_frame_stats_ + 1;
+  }
 
   if (enc->is_first_frame_) {  // Add this as a key-frame.
     error_code = SetFrame(enc, config, 1, encoded_frame, &frame_skipped);
@@ -1216,9 +1827,30 @@ static int CacheFrame(WebPAnimEncoder* const enc,
     ++enc->count_since_key_frame_;
     if (enc->count_since_key_frame_ <= enc->options_.kmin) {
       // Add this as a frame rectangle.
-      error_code = SetFrame(enc, config, 0, encoded_frame, &frame_skipped);
-      if (error_code != VP8_ENC_OK) goto End;
-      if (frame_skipped) goto Skip;
+      const ReusedFrame* reused_frame = NULL;
+      if (enc->options_.reuse_frames) {
+        reused_frame = FindReusedFrame(enc, config);
+        ++enc->num_lookups_;
+      }
+      if (reused_frame != NULL) {
+        if (!ReuseFrame(enc, config, reused_frame, encoded_frame)) {
+          error_code = VP8_ENC_ERROR_OUT_OF_MEMORY;
+          goto End;
+        }
+        ++enc->num_reuses_;
+      } else {
+        const FrameRectangle prev_rect = enc->prev_rect_;
+        const int dispose_bg_possible = !enc->prev_candidate_undecided_;
+        error_code = SetFrame(enc, config, 0, encoded_frame, &frame_skipped);
+        if (error_code != VP8_ENC_OK) goto End;
+        if (frame_skipped) goto Skip;
+        if (enc->options_.reuse_frames &&
+            !KeepReusedFrame(enc, config, &prev_rect, dispose_bg_possible,
+                             &encoded_frame->sub_frame_)) {
+          error_code = VP8_ENC_ERROR_OUT_OF_MEMORY;
+          goto End;
+        }
+      }
       encoded_frame->is_key_frame_ = 0;
       enc->flush_count_ = enc->count_ - 1;
       enc->prev_candidate_undecided_ = 0;
@@ -1226,18 +1858,12 @@ static int CacheFrame(WebPAnimEncoder* const enc,
       int64_t curr_delta;
       FrameRectangle prev_rect_key, prev_rect_sub;
 
-      // Add this as a frame rectangle to enc.
-      error_code = SetFrame(enc, config, 0, encoded_frame, &frame_skipped);
+      // Add this as a frame rectangle and as a key-frame to enc.
+      error_code = SetSubFrameAndKeyFrame(enc, config, encoded_frame,
+                                          &frame_skipped, &prev_rect_sub,
+                                          &prev_rect_key);
       if (error_code != VP8_ENC_OK) goto End;
       if (frame_skipped) goto Skip;
-      prev_rect_sub = enc->prev_rect_;
-
-
-      // Add this as a key-frame to enc, too.
-      error_code = SetFrame(enc, config, 1, encoded_frame, &frame_skipped);
-      if (error_code != VP8_ENC_OK) goto End;
-      assert(frame_skipped == 0);  // Key-frame cannot be an empty rectangle.
-      prev_rect_key = enc->prev_rect_;
 
       // Analyze size difference of the two variants.
       curr_delta = KeyFramePenalty(encoded_frame);
@@ -1271,13 +1897,17 @@ static int CacheFrame(WebPAnimEncoder* const enc,
     }
   }
 
-  // Update previous to previous and previous canvases for next call.
-  WebPCopyPixels(enc->curr_canvas_, &enc->prev_canvas_);
+  // Update previous to previous and previous canvases for next call. Only the
+  // changed pixels need to be copied.
+  CopyRectangle(enc->curr_canvas_, &enc->changed_rect_, &enc->prev_canvas_);
+  RectUnion(&enc->changed_rect_, &enc->disposed_dirty_rect_);
+  enc->prev_hash_ = enc->curr_hash_;
   enc->is_first_frame_ = 0;
 
  Skip:
   ok = 1;
   ++enc->in_frame_count_;
+  if (frame_skipped && enc->curr_stats_ != NULL) enc->curr_stats_->merged = 1;
 
  End:
   if (!ok || frame_skipped) {
@@ -1294,6 +1924,49 @@ static int CacheFrame(WebPAnimEncoder* const enc,
   return ok;
 }
 
+// Records the frame written to the muxer for 'encoded_frame' in 'stats'.
+static void UpdateOutputStats(WebPAnimFrameStats* const stats,
+                              const EncodedFrame* const encoded_frame,
+                              const WebPMuxFrameInfo* const info) {
+  int width, height;
+  stats->key_frame = encoded_frame->is_key_frame_;
+  stats->candidate = encoded_frame->candidate_[encoded_frame->is_key_frame_];
+  stats->dispose_method = info->dispose_method;
+  stats->blend_method = info->blend_method;
+  stats->x_offset = info->x_offset;
+  stats->y_offset = info->y_offset;
+  stats->width = stats->height = 0;
+  if (WebPGetInfo(info->bitstream.bytes, info->bitstream.size, &width,
+                  &height)) {
+    stats->width = width;
+    stats->height = height;
+  }
+  stats->size = info->bitstream.size;
+}
+
+// Makes room for the statistics of the frame being added and clears them.
+static int NewFrameStats(WebPAnimEncoder* const enc, int timestamp) {
+  if (enc->num_frame_stats_ == enc->frame_stats_size_) {
+    const int new_size =
+        (enc->frame_stats_size_ == 0) ? 64 : 2 * enc->frame_stats_size_;
+    WebPAnimFrameStats* const new_stats =
+        (WebPAnimFrameStats*)WebPSafeMalloc(new_size, sizeof(*new_stats));
+    if (new_stats == NULL) return 0;
+    if (enc->num_frame_stats_ > 0) {
+      memcpy(new_stats, enc->frame_stats_,
+             enc->num_frame_stats_ * sizeof(*new_stats));
+    }
+    WebPSafeFree(enc->frame_stats_);
+    enc->frame_stats_ = new_stats;
+    enc->frame_stats_size_ = new_size;
+  }
+  enc->curr_stats_ = &enc->frame_stats_[enc->num_frame_stats_];
+  memset(enc->curr_stats_, 0, sizeof(*enc->curr_stats_));
+  enc->curr_stats_->timestamp = timestamp;
+  enc->curr_stats_->candidate = -1;
+  return 1;
+}
+
 static int FlushFrames(WebPAnimEncoder* const enc) {
   while (enc->flush_count_ > 0) {
     WebPMuxError err;
@@ -1306,11 +1979,16 @@ static int FlushFrames(WebPAnimEncoder* const enc) {
       MarkError2(enc, "ERROR adding frame. WebPMuxError", err);
       return 0;
     }
+    enc->mux_bytes_ += info->bitstream.size;
     if (enc->options_.verbose) {
       fprintf(stderr, "INFO: Added frame. offset:%d,%d dispose:%d blend:%d\n",
               info->x_offset, info->y_offset, info->dispose_method,
               info->blend_method);
     }
+    if (curr->stats_index_ > 0) {
+      UpdateOutputStats(&enc->frame_stats_[curr->stats_index_ - 1], curr,
+                        info);
+    }
     ++enc->out_frame_count_;
     FrameRelease(curr);
     ++enc->start_;
@@ -1396,15 +2074,20 @@ int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
     WebPConfigInit(&config);
     config.lossless = 1;
   }
+  if (enc->options_.frame_stats && !NewFrameStats(enc, timestamp)) {
+    MarkError(enc, "ERROR adding frame: out of memory");
+    return 0;
+  }
   assert(enc->curr_canvas_ == NULL);
   enc->curr_canvas_ = frame;  // Store reference.
-  assert(enc->curr_canvas_copy_modified_ == 1);
-  CopyCurrentCanvas(enc);
 
-  ok = CacheFrame(enc, &config) && FlushFrames(enc);
+  ok = CacheFrame(enc, &config);
+  if (ok) UpdatePeakMemory(enc, 0);
+  if (ok && enc->curr_stats_ != NULL) ++enc->num_frame_stats_;
+  ok = ok && FlushFrames(enc);
 
   enc->curr_canvas_ = NULL;
-  enc->curr_canvas_copy_modified_ = 1;
+  enc->curr_stats_ = NULL;
   if (ok) {
     enc->prev_timestamp_ = timestamp;
   }
@@ -1561,11 +2244,29 @@ int WebPAnimEncoderAssemble(WebPAnimEncoder* enc, WebPData* webp_data) {
   // Assemble into a WebP bitstream.
   err = WebPMuxAssemble(mux, webp_data);
   if (err != WEBP_MUX_OK) goto Err;
+  UpdatePeakMemory(enc, webp_data->size);
 
   if (enc->out_frame_count_ == 1) {
     err = OptimizeSingleFrame(enc, webp_data);
     if (err != WEBP_MUX_OK) goto Err;
   }
+
+  if (enc->options_.verbose && enc->options_.reuse_frames) {
+    fprintf(stderr, "INFO: Reused %d of %d encoded sub-frames (%.1f%%).\n",
+            enc->num_reuses_, enc->num_lookups_,
+            enc->num_lookups_ ? 100. * enc->num_reuses_ / enc->num_lookups_
+                              : 0.);
+  }
+
+  if (enc->options_.mixed_predictor == 2) {
+    const int num_frames = enc->num_predicted_ + enc->num_undecided_;
+    fprintf(stderr, "Mixed predictor: %d frames, %d predicted, %d correct "
+            "(%.1f%%), %d undecided, %d bytes lost.\n", num_frames,
+            enc->num_predicted_, enc->num_correct_,
+            enc->num_predicted_ ? 100. * enc->num_correct_ /
+                                      enc->num_predicted_ : 100.,
+            enc->num_undecided_, (int)enc->lost_bytes_);
+  }
   return 1;
 
  Err:
@@ -1578,4 +2279,19 @@ const char* WebPAnimEncoderGetError(WebPAnimEncoder* enc) {
   return enc->error_str_;
 }
 
+const WebPAnimFrameStats* WebPAnimEncoderGetFrameStats(WebPAnimEncoder* enc,
+                                                       int* num_frames) {
+  if (num_frames != NULL) *num_frames = 0;
+  if (enc == NULL || !enc->options_.frame_stats) return NULL;
+  if (num_frames != NULL) *num_frames = enc->num_frame_stats_;
+  return enc->frame_stats_;
+}
+
+int WebPAnimEncoderGetMemory(const WebPAnimEncoder* enc,
+                             WebPAnimEncoderMemory* memory) {
+  if (enc == NULL || memory == NULL) return 0;
+  GetMemory(enc, memory);
+  return 1;
+}
+
 // -----------------------------------------------------------------------------
@@ -32,6 +32,7 @@ typedef struct WebPConfig WebPConfig;
 typedef struct WebPPicture WebPPicture;   // main structure for I/O
 typedef struct WebPAuxStats WebPAuxStats;
 typedef struct WebPMemoryWriter WebPMemoryWriter;
+typedef struct WebPLosslessCache WebPLosslessCache;
 
 // Return the encoder's version number, packed in hexadecimal using 8bits for
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
@@ -347,8 +348,12 @@ struct WebPPicture {
 
   uint32_t pad3[3];       // padding for later use
 
+  // If not NULL, lossless encoding keeps its scratch memory in this cache
+  // instead of allocating it anew (see WebPLosslessCacheNew()).
+  WebPLosslessCache* lossless_cache;
+
   // Unused for now
-  uint8_t* pad4, *pad5;
+  uint8_t* pad5;
   uint32_t pad6[8];       // padding for later use
 
   // PRIVATE FIELDS
@@ -538,6 +543,19 @@ WEBP_EXTERN void WebPBlendAlpha(WebPPicture* pic, uint32_t background_rgb);
 // another is provided but they both incur some loss.
 WEBP_EXTERN int WebPEncode(const WebPConfig* config, WebPPicture* picture);
 
+// Lossless encoder scratch memory (hash chain, backward references and
+// transform buffers) kept across WebPEncode() calls. The buffers grow to the
+// largest picture encoded with the cache and are reused for the following
+// ones, which saves the allocations when encoding many pictures of similar
+// size, e.g. animation frames. The last palette is kept too, and reused by
+// pictures made of the same colors. Set 'picture->lossless_cache' to use it.
+// A cache must not be used by two encodings at the same time.
+// Returns NULL in case of memory error.
+WEBP_EXTERN WebPLosslessCache* WebPLosslessCacheNew(void);
+
+// Releases the memory held by 'cache'.
+WEBP_EXTERN void WebPLosslessCacheDelete(WebPLosslessCache* cache);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -21,7 +21,7 @@
 extern "C" {
 #endif
 
-#define WEBP_MUX_ABI_VERSION 0x0108        // MAJOR(8b) + MINOR(8b)
+#define WEBP_MUX_ABI_VERSION 0x0200        // MAJOR(8b) + MINOR(8b)
 
 //------------------------------------------------------------------------------
 // Mux API
@@ -437,8 +437,22 @@ struct WebPAnimEncoderOptions {
   int allow_mixed;      // If true, use mixed compression mode; may choose
                         // either lossy and lossless for each frame.
   int verbose;          // If true, print info and warning messages to stderr.
-
-  uint32_t padding[4];  // Padding for later use.
+  int mixed_predictor;  // With 'allow_mixed', for frames whose palette size
+                        // doesn't settle it, predict from the frame content
+                        // whether lossless or lossy compression is smaller
+                        // and only try that one: 0 = off (try both), 1 = on
+                        // (default), 2 = try both and print the accuracy of
+                        // the prediction to stderr on assembly.
+  int reuse_frames;     // If true (default), a frame that repeats an earlier
+                        // sub-frame on the same previous canvas, in the same
+                        // encoder state, reuses the bitstream encoded for it
+                        // instead of being encoded again. The output is the
+                        // same either way.
+  int frame_stats;      // If true, keep the per-frame statistics returned by
+                        // WebPAnimEncoderGetFrameStats(). Also times the
+                        // candidate encodings, which adds a little overhead.
+
+  uint32_t padding[1];  // Padding for later use.
 };
 
 // Internal, version-checked, entry point.
@@ -486,7 +500,8 @@ static WEBP_INLINE WebPAnimEncoder* WebPAnimEncoderNew(
 //                       "timestamp of next frame - timestamp of this frame".
 //                       Hence, timestamps should be in non-decreasing order.
 //   config - (in) encoding options; can be passed NULL to pick
-//            reasonable defaults.
+//            reasonable defaults. If 'config->thread_level' is non-zero, the
+//            candidate encodings of the frame are run concurrently.
 // Returns:
 //   On error, returns false and frame->error_code is set appropriately.
 //   Otherwise, returns true.
@@ -516,6 +531,78 @@ WEBP_EXTERN int WebPAnimEncoderAssemble(WebPAnimEncoder* enc,
 //   to 'enc' had an error, or an empty string if the last call was a success.
 WEBP_EXTERN const char* WebPAnimEncoderGetError(WebPAnimEncoder* enc);
 
+// Candidate encodings tried for a frame. The dispose method is the one the
+// candidate assumes for the previous frame.
+typedef enum WebPAnimCandidate {
+  WEBP_ANIM_LOSSLESS_DISPOSE_NONE = 0,
+  WEBP_ANIM_LOSSLESS_DISPOSE_BACKGROUND,
+  WEBP_ANIM_LOSSY_DISPOSE_NONE,
+  WEBP_ANIM_LOSSY_DISPOSE_BACKGROUND,
+  WEBP_ANIM_CANDIDATE_COUNT
+} WebPAnimCandidate;
+
+// Size and encoding time of a candidate; both are 0 if it wasn't tried.
+typedef struct {
+  size_t size;     // Encoded size in bytes.
+  double time_ms;  // Wall-clock encoding time, including the preparation of
+                   // the candidate's canvas.
+} WebPAnimCandidateStats;
+
+// Statistics of one frame given to WebPAnimEncoderAdd().
+typedef struct {
+  int timestamp;  // Timestamp of the frame in milliseconds.
+  int merged;     // True if the frame repeats the previous one and only
+                  // extends its duration. Nothing else is set.
+  int reused;     // True if the encoding of an earlier identical frame was
+                  // reused. The candidates are not set.
+  int key_frame;  // True if the frame is output as a key-frame.
+  int candidate;  // WebPAnimCandidate picked for the output frame, -1 if
+                  // reused.
+  WebPMuxAnimDispose dispose_method;  // Of the output frame.
+  WebPMuxAnimBlend blend_method;      // Of the output frame.
+  int x_offset, y_offset, width, height;  // Frame rectangle.
+  size_t size;    // Size of the output frame bitstream in bytes.
+  // Candidates tried as a sub-frame and, when key-frames are inserted or for
+  // the first frame, as a key-frame; indexed by WebPAnimCandidate.
+  WebPAnimCandidateStats sub_frame_candidates[WEBP_ANIM_CANDIDATE_COUNT];
+  WebPAnimCandidateStats key_frame_candidates[WEBP_ANIM_CANDIDATE_COUNT];
+} WebPAnimFrameStats;
+
+// Get the statistics of the frames added so far, in the order they were
+// added. The output frame is only known for frames written to the muxer,
+// which is guaranteed for all frames after WebPAnimEncoderAssemble().
+// Parameters:
+//   enc - (in) object the frames were added to.
+//   num_frames - (out) number of entries in the returned array.
+// Returns:
+//   NULL if 'enc' is NULL or 'enc_options->frame_stats' was not set.
+//   Otherwise, the statistics. They are owned by 'enc' and are valid until
+//   the next call to WebPAnimEncoderAdd() or WebPAnimEncoderDelete().
+WEBP_EXTERN const WebPAnimFrameStats* WebPAnimEncoderGetFrameStats(
+    WebPAnimEncoder* enc, int* num_frames);
+
+// Memory held by a WebPAnimEncoder, in bytes.
+typedef struct {
+  size_t canvases;    // Canvases the frames are compared and encoded on.
+  size_t frames;      // Encoded frames not yet added to the muxer, frames kept
+                      // for reuse and per-frame statistics.
+  size_t candidates;  // Largest total of the encoded candidates of a frame.
+                      // They are only held while the frame is being added.
+  size_t mux;         // Frames copied into the muxer.
+  size_t peak;        // Highest total so far, counting the candidates while
+                      // they are held and the output of
+                      // WebPAnimEncoderAssemble().
+} WebPAnimEncoderMemory;
+
+// Get the memory held by 'enc'.
+// Parameters:
+//   enc - (in) object to be queried.
+//   memory - (out) memory held by 'enc'.
+// Returns:
+//   False if 'enc' or 'memory' is NULL.
+WEBP_EXTERN int WebPAnimEncoderGetMemory(const WebPAnimEncoder* enc,
+                                         WebPAnimEncoderMemory* memory);
+
 // Deletes the WebPAnimEncoder object.
 // Parameters:
 //   enc - (in/out) object to be deleted
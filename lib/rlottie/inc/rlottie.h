@@ -60,6 +60,167 @@ namespace rlottie {
  */
 LOT_EXPORT void configureModelCacheSize(size_t cacheSize);
 
+/**
+ *  @brief Configures the memory limit of the offscreen surface cache.
+ *
+ *  Matte and precomp layers are rendered into offscreen surfaces which
+ *  are kept around for the next frame. This limits the memory held by
+ *  the idle surfaces of all the animations together.
+ *
+ *  @param[in] cacheSize  Maximum memory in bytes.
+ *
+ *  @note surfaces already in the cache are freed lazily, configure it
+ *        with 0 to stop caching surfaces.
+ *
+ *  @internal
+ */
+LOT_EXPORT void configureSurfaceCacheSize(size_t cacheSize);
+
+struct SurfaceCacheStats {
+    size_t hits{0};       // surfaces reused from the cache
+    size_t misses{0};     // surfaces which had to be allocated
+    size_t evictions{0};  // surfaces freed because the cache was full
+    size_t bytes{0};      // memory held by the idle surfaces
+    size_t peakBytes{0};  // highest value of bytes so far
+};
+
+/**
+ *  @brief Returns the offscreen surface cache statistics.
+ *
+ *  @internal
+ */
+LOT_EXPORT SurfaceCacheStats surfaceCacheStats();
+
+/**
+ *  @brief Starts recording a trace of the rendering.
+ *
+ *  Records the time spent updating, preprocessing, rasterizing and
+ *  drawing the layers of all the animations, and per frame counters of
+ *  the blended spans, rle operations and allocated surfaces.
+ *
+ *  @return false if rlottie is built without LOTTIE_TRACE.
+ *
+ *  @see writeTrace()
+ *
+ *  @internal
+ */
+LOT_EXPORT bool startTrace();
+
+/**
+ *  @brief Stops recording the trace and writes it to a file.
+ *
+ *  The trace is written in the Chrome trace event format, which
+ *  chrome://tracing and ui.perfetto.dev can open.
+ *
+ *  @param[in] path  File to write the trace to.
+ *
+ *  @return false if the file could not be written or rlottie is built
+ *          without LOTTIE_TRACE.
+ *
+ *  @internal
+ */
+LOT_EXPORT bool writeTrace(const std::string &path);
+
+struct RenderLimits {
+    size_t maxRepeaterCopies{0};  // copies of a repeater, multiplied by
+                                  // the copies of the repeaters around it
+    size_t maxPathPoints{0};      // points of a path or mask after dashing
+    size_t maxPrecompDepth{0};    // nesting of precomp layers
+    double maxFrameMs{0};         // time to update and render a frame
+};
+
+enum class RenderError {
+    None,
+    RepeaterCopies,  // the animation exceeds maxRepeaterCopies
+    PathPoints,      // a path of the frame exceeds maxPathPoints
+    PrecompDepth,    // the animation exceeds maxPrecompDepth
+    FrameTime        // the frame took longer than maxFrameMs
+};
+
+/**
+ *  @brief Configures the limits on the work of rendering an animation.
+ *
+ *  Protects the renderer from inputs which would take too long or too
+ *  much memory to render. The structure of the animation is checked when
+ *  it is loaded, the paths and the time when a frame is rendered, which
+ *  stops at the next layer once a limit is exceeded. From then on the
+ *  Animation renders nothing and renderError() tells why.
+ *
+ *  @param[in] limits  Limits of the animations loaded afterwards, 0 for
+ *                     no limit.
+ *
+ *  @note paths which the rasterizer can't hold are drawn empty, and
+ *        reported as RenderError::PathPoints once any limit is set.
+ *
+ *  @internal
+ */
+LOT_EXPORT void configureRenderLimits(const RenderLimits &limits);
+
+struct RenderTimings {
+    size_t frames{0};       // frames rendered
+    double updateMs{0};     // updating the layers to the frame
+    double rasterizeMs{0};  // preprocessing the layers, where paths are
+                            // rasterized or handed to the render threads
+    double blendMs{0};      // drawing the layers onto the surface, including
+                            // waiting for the render threads
+};
+
+enum class RenderPhase {
+    Update,     // RenderTimings::updateMs
+    Rasterize,  // RenderTimings::rasterizeMs
+    Blend       // RenderTimings::blendMs
+};
+
+using RenderPhaseHook = void (*)(RenderPhase phase, bool end);
+
+/**
+ *  @brief Sets a function which is called when each phase of rendering a
+ *         frame begins and ends.
+ *
+ *  The phases are those of Animation::renderTimings(), the hook lets a
+ *  profiler attribute its own measurements, such as hardware counters,
+ *  to them. It is called on the thread which renders the frame.
+ *
+ *  @param[in] hook  Function to call, nullptr to remove it.
+ *
+ *  @internal
+ */
+LOT_EXPORT void configureRenderPhaseHook(RenderPhaseHook hook);
+
+struct MemoryUsage {
+    size_t modelBytes{0};        // model objects, path points, keyframes
+                                 // and baked values
+    size_t rendererBytes{0};     // render tree of the Animation
+    size_t surfaceBytes{0};      // offscreen surfaces, in use or cached
+    size_t peakSurfaceBytes{0};  // highest value of surfaceBytes so far
+    size_t rleBytes{0};          // spans of the rasterized shapes and
+                                 // masks of all the animations
+    size_t peakRleBytes{0};      // highest value of rleBytes so far
+};
+
+struct Complexity {
+    size_t layers{0};           // layers, counting the precomp children once
+                                // per referencing layer
+    size_t shapes{0};           // path, rect, ellipse and polystar items
+    size_t fills{0};            // fills, including gradient fills
+    size_t strokes{0};          // strokes, including gradient strokes
+    size_t gradients{0};        // gradient fills and strokes
+    size_t trimPaths{0};
+    size_t repeaters{0};
+    size_t masks{0};
+    size_t mattes{0};           // layers with a track matte
+    size_t keyFrames{0};
+    size_t imageAssets{0};
+    size_t maxMatteDepth{0};    // nesting of matted layers
+    size_t maxMaskDepth{0};     // nesting of masked layers
+    size_t maxPrecompDepth{0};  // nesting of precomp layers
+    size_t maxRepeaterCopies{0};  // copies of a repeater, multiplied by
+                                  // the copies of the repeaters around it
+    double cost{0};             // estimated time in ms to render all the
+                                // frames at 512x512 and encode them
+                                // losslessly, to order animations by
+};
+
 struct Color {
     Color() = default;
     Color(float r, float g , float b):_r(r), _g(g), _b(b){}
@@ -431,6 +592,68 @@ public:
      */
     const LOTLayerNode * renderTree(size_t frameNo, size_t width, size_t height) const;
 
+    /**
+     *  @brief Evaluates the animated properties for every frame up front so
+     *         that updating a frame only has to look the values up.
+     *         Useful when all the frames are going to be rendered anyway.
+     *         Properties that don't fit in @p memoryBudget keep being
+     *         evaluated from their keyframes.
+     *
+     *  @param[in] memoryBudget maximum number of bytes to spend.
+     *
+     *  @return number of bytes used by the baked values.
+     *
+     *  @note The model is shared by all the Animation objects loaded from
+     *        the same cached resource, call it before rendering starts.
+     *
+     *  @internal
+     */
+    size_t bake(size_t memoryBudget);
+
+    /**
+     *  @brief Returns the time spent in each phase of rendering, summed over
+     *         the frames rendered since the Animation was loaded or
+     *         resetRenderTimings() was called.
+     *
+     *  @internal
+     */
+    RenderTimings renderTimings() const;
+
+    /**
+     *  @brief Clears the time spent rendering, @see renderTimings.
+     *
+     *  @internal
+     */
+    void resetRenderTimings();
+
+    /**
+     *  @brief Returns the memory held by the Animation.
+     *
+     *  @note The model is shared by all the Animation objects loaded from
+     *        the same cached resource.
+     *
+     *  @internal
+     */
+    MemoryUsage memoryUsage() const;
+
+    /**
+     *  @brief Returns the size and structure of the animation, and the cost
+     *         of converting it estimated from them, without rendering it.
+     *
+     *  @internal
+     */
+    Complexity complexity() const;
+
+    /**
+     *  @brief Returns the limit the Animation exceeded, @see
+     *         configureRenderLimits. The frame which exceeded it is left
+     *         partly drawn, the following ones leave the surface untouched
+     *         and renderTree() returns nullptr.
+     *
+     *  @internal
+     */
+    RenderError renderError() const;
+
     /**
      *  @brief Returns Composition Markers.
      *
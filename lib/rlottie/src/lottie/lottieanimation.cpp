@@ -19,6 +19,7 @@
 #include "lottieitem.h"
 #include "lottiemodel.h"
 #include "rlottie.h"
+#include "vtrace.h"
 
 #include <fstream>
 
@@ -30,6 +31,45 @@ LOT_EXPORT void rlottie::configureModelCacheSize(size_t cacheSize)
     internal::model::configureModelCacheSize(cacheSize);
 }
 
+LOT_EXPORT void rlottie::configureSurfaceCacheSize(size_t cacheSize)
+{
+    internal::renderer::configureSurfaceCacheSize(cacheSize);
+}
+
+LOT_EXPORT SurfaceCacheStats rlottie::surfaceCacheStats()
+{
+    return internal::renderer::surfaceCacheStats();
+}
+
+LOT_EXPORT void rlottie::configureRenderLimits(const RenderLimits &limits)
+{
+    internal::renderer::configureRenderLimits(limits);
+}
+
+LOT_EXPORT void rlottie::configureRenderPhaseHook(RenderPhaseHook hook)
+{
+    internal::renderer::configureRenderPhaseHook(hook);
+}
+
+LOT_EXPORT bool rlottie::startTrace()
+{
+#ifdef LOTTIE_TRACE_SUPPORT
+    return VTrace::start();
+#else
+    return false;
+#endif
+}
+
+LOT_EXPORT bool rlottie::writeTrace(const std::string &path)
+{
+#ifdef LOTTIE_TRACE_SUPPORT
+    return VTrace::write(path);
+#else
+    (void)path;
+    return false;
+#endif
+}
+
 struct RenderTask {
     RenderTask() { receiver = sender.get_future(); }
     std::promise<Surface> sender;
@@ -50,6 +90,18 @@ public:
     double  frameRate() const { return mModel->frameRate(); }
     size_t  totalFrame() const { return mModel->totalFrame(); }
     size_t  frameAtPos(double pos) const { return mModel->frameAtPos(pos); }
+    size_t  bake(size_t budget) { return mModel->bakeProperties(budget); }
+    RenderTimings renderTimings() const
+    {
+        return mRenderer ? mRenderer->timings() : RenderTimings();
+    }
+    void resetRenderTimings()
+    {
+        if (mRenderer) mRenderer->resetTimings();
+    }
+    RenderError   renderError() const { return mError; }
+    Complexity    complexity() const;
+    MemoryUsage   memoryUsage() const;
     Surface render(size_t frameNo, const Surface &surface,
                    bool keepAspectRatio);
     std::future<Surface> renderAsync(size_t frameNo, Surface &&surface,
@@ -70,22 +122,31 @@ public:
 private:
     mutable LayerInfoList                  mLayerList;
     model::Composition *                   mModel;
+    // owns mModel also when the limits leave the animation without renderer.
+    std::shared_ptr<model::Composition>    mComposition;
     SharedRenderTask                       mTask;
     std::atomic<bool>                      mRenderInProgress;
+    std::atomic<RenderError>               mError{RenderError::None};
+    RenderLimits                           mLimits;
     std::unique_ptr<renderer::Composition> mRenderer{nullptr};
 };
 
 void AnimationImpl::setValue(const std::string &keypath, LOTVariant &&value)
 {
-    if (keypath.empty()) return;
+    if (keypath.empty() || !mRenderer) return;
     mRenderer->setValue(keypath, value);
 }
 
 const LOTLayerNode *AnimationImpl::renderTree(size_t frameNo, const VSize &size)
 {
-    if (update(frameNo, size, true)) {
-        mRenderer->buildRenderTree();
-    }
+    if (mError != RenderError::None) return nullptr;
+
+    renderer::FrameGuard guard(mLimits);
+    bool                 updated = update(frameNo, size, true);
+    mError = guard.error();
+    if (!guard.ok()) return nullptr;
+
+    if (updated) mRenderer->buildRenderTree();
     return mRenderer->renderTree();
 }
 
@@ -110,12 +171,23 @@ Surface AnimationImpl::render(size_t frameNo, const Surface &surface,
         return surface;
     }
 
+    if (mError != RenderError::None) return surface;
+
     mRenderInProgress.store(true);
+#ifdef LOTTIE_LOGGING_SUPPORT
+    auto detachCount = vcowDetachCount().load();
+#endif
+    renderer::FrameGuard guard(mLimits);
     update(
         frameNo,
         VSize(int(surface.drawRegionWidth()), int(surface.drawRegionHeight())),
         keepAspectRatio);
-    mRenderer->render(surface);
+    if (guard.ok()) mRenderer->render(surface);
+    mError = guard.error();
+#ifdef LOTTIE_LOGGING_SUPPORT
+    vDebug << "frame " << frameNo << " path/rle copies : "
+           << vcowDetachCount().load() - detachCount;
+#endif
     mRenderInProgress.store(false);
 
     return surface;
@@ -123,9 +195,59 @@ Surface AnimationImpl::render(size_t frameNo, const Surface &surface,
 
 void AnimationImpl::init(std::shared_ptr<model::Composition> composition)
 {
+    mComposition = composition;
     mModel = composition.get();
-    mRenderer = std::make_unique<renderer::Composition>(composition);
     mRenderInProgress = false;
+    mLimits = renderer::renderLimits();
+
+    // building the render tree of such an animation already takes too long.
+    const auto &stats = mModel->mStats;
+    if (mLimits.maxPrecompDepth &&
+        stats.maxPrecompDepth > mLimits.maxPrecompDepth) {
+        mError = RenderError::PrecompDepth;
+        return;
+    }
+    if (mLimits.maxRepeaterCopies &&
+        stats.maxRepeaterCopies > mLimits.maxRepeaterCopies) {
+        mError = RenderError::RepeaterCopies;
+        return;
+    }
+    mRenderer = std::make_unique<renderer::Composition>(composition);
+}
+
+MemoryUsage AnimationImpl::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.modelBytes = mModel->memoryUsage();
+    if (mRenderer) mRenderer->memoryUsage(usage);
+    usage.rleBytes = VRleMemory::bytes();
+    usage.peakRleBytes = VRleMemory::peakBytes();
+    return usage;
+}
+
+Complexity AnimationImpl::complexity() const
+{
+    const auto &stats = mModel->mStats;
+    Complexity  result;
+    result.layers = size_t(stats.precompLayerCount) + stats.solidLayerCount +
+                    stats.shapeLayerCount + stats.imageLayerCount +
+                    stats.nullLayerCount;
+    result.shapes = stats.shapeCount;
+    result.fills = stats.fillCount;
+    result.strokes = stats.strokeCount;
+    result.gradients = stats.gradientCount;
+    result.trimPaths = stats.trimCount;
+    result.repeaters = stats.repeaterCount;
+    result.masks = stats.maskCount;
+    result.mattes = stats.matteCount;
+    result.keyFrames = stats.keyFrameCount;
+    result.imageAssets = stats.imageAssetCount;
+    result.maxMatteDepth = stats.maxMatteDepth;
+    result.maxMaskDepth = stats.maxMaskDepth;
+    result.maxPrecompDepth = stats.maxPrecompDepth;
+    result.maxRepeaterCopies = stats.maxRepeaterCopies;
+    result.cost = stats.cost;
+    return result;
 }
 
 #ifdef LOTTIE_THREAD_SUPPORT
@@ -351,6 +473,36 @@ void Animation::renderSync(size_t frameNo, Surface surface,
     d->render(frameNo, surface, keepAspectRatio);
 }
 
+size_t Animation::bake(size_t memoryBudget)
+{
+    return d->bake(memoryBudget);
+}
+
+RenderTimings Animation::renderTimings() const
+{
+    return d->renderTimings();
+}
+
+void Animation::resetRenderTimings()
+{
+    d->resetRenderTimings();
+}
+
+MemoryUsage Animation::memoryUsage() const
+{
+    return d->memoryUsage();
+}
+
+Complexity Animation::complexity() const
+{
+    return d->complexity();
+}
+
+RenderError Animation::renderError() const
+{
+    return d->renderError();
+}
+
 const LayerInfoList &Animation::layers() const
 {
     return d->layerInfoList();
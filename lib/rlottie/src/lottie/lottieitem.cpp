@@ -18,12 +18,17 @@
 
 #include "lottieitem.h"
 #include <algorithm>
+#include <atomic>
+#include <climits>
 #include <cmath>
 #include <iterator>
+#include <mutex>
 #include "lottiekeypath.h"
 #include "vbitmap.h"
+#include "velapsedtimer.h"
 #include "vpainter.h"
 #include "vraster.h"
+#include "vtrace.h"
 
 /* Lottie Layer Rules
  * 1. time stretch is pre calculated and applied to all the properties of the
@@ -93,6 +98,210 @@ static renderer::Layer *createLayerItem(model::Layer *layerData,
     }
 }
 
+namespace {
+struct SurfaceCacheState {
+    std::atomic<size_t> mMaxBytes{32 * 1024 * 1024};
+    std::atomic<size_t> mBytes{0};
+    std::atomic<size_t> mPeakBytes{0};
+    std::atomic<size_t> mHits{0};
+    std::atomic<size_t> mMisses{0};
+    std::atomic<size_t> mEvictions{0};
+};
+}  // namespace
+
+static SurfaceCacheState &surfaceCacheState()
+{
+    static SurfaceCacheState state;
+    return state;
+}
+
+static size_t surfaceBytes(const VBitmap &surface)
+{
+    return surface.stride() * surface.height();
+}
+
+// surfaces grow in steps of 64 pixels so that they can be reused when
+// the content size changes a little between the frames.
+static size_t surfaceSizeClass(size_t size)
+{
+    return (size + 63) & ~size_t(63);
+}
+
+void renderer::configureSurfaceCacheSize(size_t cacheSize)
+{
+    surfaceCacheState().mMaxBytes = cacheSize;
+}
+
+rlottie::SurfaceCacheStats renderer::surfaceCacheStats()
+{
+    auto &                     state = surfaceCacheState();
+    rlottie::SurfaceCacheStats stats;
+    stats.hits = state.mHits;
+    stats.misses = state.mMisses;
+    stats.evictions = state.mEvictions;
+    stats.bytes = state.mBytes;
+    stats.peakBytes = state.mPeakBytes;
+    return stats;
+}
+
+namespace {
+struct RenderLimitsState {
+    std::mutex            mMutex;
+    rlottie::RenderLimits mLimits;
+};
+}  // namespace
+
+static RenderLimitsState &renderLimitsState()
+{
+    static RenderLimitsState state;
+    return state;
+}
+
+void renderer::configureRenderLimits(const rlottie::RenderLimits &limits)
+{
+    auto &                      state = renderLimitsState();
+    std::lock_guard<std::mutex> lock(state.mMutex);
+    state.mLimits = limits;
+}
+
+rlottie::RenderLimits renderer::renderLimits()
+{
+    auto &                      state = renderLimitsState();
+    std::lock_guard<std::mutex> lock(state.mMutex);
+    return state.mLimits;
+}
+
+static std::atomic<rlottie::RenderPhaseHook> &renderPhaseHook()
+{
+    static std::atomic<rlottie::RenderPhaseHook> hook{nullptr};
+    return hook;
+}
+
+void renderer::configureRenderPhaseHook(rlottie::RenderPhaseHook hook)
+{
+    renderPhaseHook() = hook;
+}
+
+static void renderPhase(rlottie::RenderPhase phase, bool end)
+{
+    auto hook = renderPhaseHook().load(std::memory_order_relaxed);
+    if (hook) hook(phase, end);
+}
+
+thread_local renderer::FrameGuard *renderer::FrameGuard::sCurrent = nullptr;
+
+renderer::FrameGuard::FrameGuard(const rlottie::RenderLimits &limits)
+    : mPrevious(sCurrent), mLimits(limits)
+{
+    mLimited = limits.maxRepeaterCopies || limits.maxPathPoints ||
+               limits.maxPrecompDepth || limits.maxFrameMs > 0;
+    mTimer.start();
+    sCurrent = this;
+}
+
+renderer::FrameGuard::~FrameGuard()
+{
+    sCurrent = mPrevious;
+}
+
+bool renderer::FrameGuard::check()
+{
+    auto guard = sCurrent;
+    if (!guard) return true;
+
+    if (guard->ok() && guard->mLimits.maxFrameMs > 0 &&
+        guard->mTimer.elapsed() > guard->mLimits.maxFrameMs)
+        guard->mError = rlottie::RenderError::FrameTime;
+    return guard->ok();
+}
+
+size_t renderer::FrameGuard::maxPathPoints()
+{
+    auto guard = sCurrent;
+    if (!guard || !guard->mLimited) return 0;
+
+    // the paths the rasterizer can't hold are reported too.
+    size_t limit = guard->mLimits.maxPathPoints;
+    return limit ? std::min(limit, size_t(SHRT_MAX)) : size_t(SHRT_MAX);
+}
+
+bool renderer::FrameGuard::checkPath(size_t points)
+{
+    size_t limit = maxPathPoints();
+    if (!limit || points <= limit) return true;
+
+    fail(rlottie::RenderError::PathPoints);
+    return false;
+}
+
+void renderer::FrameGuard::fail(rlottie::RenderError error)
+{
+    if (sCurrent && sCurrent->ok()) sCurrent->mError = error;
+}
+
+renderer::SurfaceCache::~SurfaceCache()
+{
+    for (const auto &surface : mCache)
+        surfaceCacheState().mBytes -= surfaceBytes(surface);
+}
+
+VBitmap renderer::SurfaceCache::make_surface(size_t width, size_t height,
+                                             VBitmap::Format format)
+{
+    auto &state = surfaceCacheState();
+
+    // pick the smallest surface the request fits in.
+    auto best = mCache.end();
+    for (auto it = mCache.begin(); it != mCache.end(); ++it) {
+        if (it->format() != format || it->width() < width ||
+            it->height() < height)
+            continue;
+        if (best == mCache.end() || surfaceBytes(*it) < surfaceBytes(*best))
+            best = it;
+    }
+
+    if (best == mCache.end()) {
+        state.mMisses++;
+        vTraceCount(SurfacesAllocated, 1);
+        VBitmap surface(surfaceSizeClass(width), surfaceSizeClass(height),
+                        format);
+        mInUseBytes += surfaceBytes(surface);
+        mPeakBytes = std::max(mPeakBytes, bytes());
+        return surface;
+    }
+
+    state.mHits++;
+    VBitmap surface = *best;
+    state.mBytes -= surfaceBytes(surface);
+    mCachedBytes -= surfaceBytes(surface);
+    mInUseBytes += surfaceBytes(surface);
+    *best = mCache.back();
+    mCache.pop_back();
+    return surface;
+}
+
+void renderer::SurfaceCache::release_surface(VBitmap &surface)
+{
+    if (!surface.valid()) return;
+
+    auto & state = surfaceCacheState();
+    size_t bytes = surfaceBytes(surface);
+    mInUseBytes -= std::min(mInUseBytes, bytes);
+    size_t total = state.mBytes.fetch_add(bytes) + bytes;
+    if (total > state.mMaxBytes) {
+        state.mBytes -= bytes;
+        state.mEvictions++;
+        return;
+    }
+    mCachedBytes += bytes;
+
+    size_t peak = state.mPeakBytes;
+    while (total > peak && !state.mPeakBytes.compare_exchange_weak(peak, total))
+        ;
+
+    mCache.push_back(surface);
+}
+
 renderer::Composition::Composition(std::shared_ptr<model::Composition> model)
     : mCurFrameNo(-1)
 {
@@ -117,6 +326,11 @@ bool renderer::Composition::update(int frameNo, const VSize &size,
         (mKeepAspectRatio == keepAspectRatio))
         return false;
 
+    vTraceSpan("Composition::update");
+    renderPhase(rlottie::RenderPhase::Update, false);
+    VElapsedTimer timer;
+    timer.start();
+
     mViewSize = size;
     mCurFrameNo = frameNo;
     mKeepAspectRatio = keepAspectRatio;
@@ -140,11 +354,18 @@ bool renderer::Composition::update(int frameNo, const VSize &size,
         m.scale(sx, sy);
     }
     mRootLayer->update(frameNo, m, 1.0);
+    mTimings.updateMs += timer.elapsed();
+    renderPhase(rlottie::RenderPhase::Update, true);
     return true;
 }
 
 bool renderer::Composition::render(const rlottie::Surface &surface)
 {
+    vTraceSpan("Composition::render");
+    renderPhase(rlottie::RenderPhase::Rasterize, false);
+    VElapsedTimer timer;
+    timer.start();
+
     mSurface.reset(reinterpret_cast<uchar *>(surface.buffer()),
                    uint(surface.width()), uint(surface.height()),
                    uint(surface.bytesPerLine()),
@@ -155,6 +376,10 @@ bool renderer::Composition::render(const rlottie::Surface &surface)
     VRect clip(0, 0, int(surface.drawRegionWidth()),
                int(surface.drawRegionHeight()));
     mRootLayer->preprocess(clip);
+    mTimings.rasterizeMs += timer.elapsed();
+    renderPhase(rlottie::RenderPhase::Rasterize, true);
+    renderPhase(rlottie::RenderPhase::Blend, false);
+    timer.start();
 
     VPainter painter(&mSurface);
     // set sub surface area for drawing.
@@ -163,9 +388,20 @@ bool renderer::Composition::render(const rlottie::Surface &surface)
               int(surface.drawRegionWidth()), int(surface.drawRegionHeight())));
     mRootLayer->render(&painter, {}, {}, mSurfaceCache);
     painter.end();
+    mTimings.blendMs += timer.elapsed();
+    renderPhase(rlottie::RenderPhase::Blend, true);
+    mTimings.frames++;
+    vTraceSampleCounters();
     return true;
 }
 
+void renderer::Composition::memoryUsage(rlottie::MemoryUsage &usage) const
+{
+    usage.rendererBytes = mAllocator.heapBytes();
+    usage.surfaceBytes = mSurfaceCache.bytes();
+    usage.peakSurfaceBytes = mSurfaceCache.peakBytes();
+}
+
 void renderer::Mask::update(int frameNo, const VMatrix &parentMatrix,
                             float /*parentAlpha*/, const DirtyFlag &flag)
 {
@@ -200,7 +436,7 @@ VRle renderer::Mask::rle()
 
 void renderer::Mask::preprocess(const VRect &clip)
 {
-    if (mRasterRequest)
+    if (mRasterRequest && FrameGuard::checkPath(mFinalPath.points().size()))
         mRasterizer.rasterize(mFinalPath, FillRule::Winding, clip);
 }
 
@@ -213,8 +449,12 @@ void renderer::Layer::render(VPainter *painter, const VRle &inheritMask,
 
     VRle mask;
     if (mLayerMask) {
-        mask = mLayerMask->maskRle(painter->clipBoundingRect());
-        if (!inheritMask.empty()) mask = mask & inheritMask;
+        mask = mLayerMask->maskRle();
+        if (!inheritMask.empty()) {
+            mMaskRle.clone(mask);
+            mMaskRle &= inheritMask;
+            mask = mMaskRle;
+        }
         // if resulting mask is empty then return.
         if (mask.empty()) return;
     } else {
@@ -248,8 +488,21 @@ void renderer::Layer::render(VPainter *painter, const VRle &inheritMask,
     }
 }
 
+VRect renderer::Layer::renderBounds()
+{
+    VRect bounds;
+    for (auto &i : renderList()) bounds = bounds.united(i->rle().boundingRect());
+    return bounds;
+}
+
 void renderer::LayerMask::preprocess(const VRect &clip)
 {
+    // the inverted masks cover the clip area.
+    if (mClip != clip) {
+        mClip = clip;
+        mDirty = true;
+    }
+
     for (auto &i : mMasks) {
         i.preprocess(clip);
     }
@@ -278,8 +531,9 @@ void renderer::LayerMask::update(int frameNo, const VMatrix &parentMatrix,
     mDirty = true;
 }
 
-VRle renderer::LayerMask::maskRle(const VRect &clipRect)
+VRle renderer::LayerMask::maskRle()
 {
+    const VRect &clipRect = mClip;
     if (!mDirty) return mRle;
 
     VRle rle;
@@ -431,6 +685,7 @@ void renderer::Layer::preprocess(const VRect &clip)
     // layer dosen't contribute to the frame
     if (skipRendering()) return;
 
+    vTraceSpan("Layer::preprocess");
     // preprocess layer masks
     if (mLayerMask) mLayerMask->preprocess(clip);
 
@@ -471,6 +726,30 @@ renderer::CompLayer::CompLayer(model::Layer *layerModel, VArenaAlloc *allocator)
     if (mLayers.size() > 1) setComplexContent(true);
 }
 
+/*
+ * Area of the offscreen buffer for the given content bounds. The left edge
+ * is aligned to 4 pixels so that the rows keep the same 16 byte alignment
+ * as the target buffer and the simd blend functions stay on the fast path.
+ */
+static VRect offscreenArea(const VRect &clip, const VRect &bounds)
+{
+    VRect area = clip & bounds;
+    if (area.empty()) return {};
+
+    area.setLeft(std::max(clip.left(), area.left() & ~3));
+    return area;
+}
+
+VRect renderer::CompLayer::renderBounds()
+{
+    VRect bounds;
+    for (const auto &layer : mLayers) {
+        if (layer->visible()) bounds = bounds.united(layer->renderBounds());
+    }
+    if (mClipper) bounds = bounds & mClipper->bounds();
+    return bounds;
+}
+
 void renderer::CompLayer::render(VPainter *painter, const VRle &inheritMask,
                                  const VRle &matteRle, SurfaceCache &cache)
 {
@@ -480,13 +759,15 @@ void renderer::CompLayer::render(VPainter *painter, const VRle &inheritMask,
         renderHelper(painter, inheritMask, matteRle, cache);
     } else {
         if (complexContent()) {
-            VSize    size = painter->clipBoundingRect().size();
+            VRect area = offscreenArea(painter->clipBoundingRect(), renderBounds());
+            if (area.empty()) return;
+
             VPainter srcPainter;
-            VBitmap srcBitmap = cache.make_surface(size.width(), size.height());
-            srcPainter.begin(&srcBitmap);
+            VBitmap  srcBitmap = cache.make_surface(area.width(), area.height());
+            srcPainter.begin(&srcBitmap, area);
             renderHelper(&srcPainter, inheritMask, matteRle, cache);
             srcPainter.end();
-            painter->drawBitmap(VPoint(), srcBitmap,
+            painter->drawBitmap(area, srcBitmap, VRect(VPoint(), area.size()),
                                 uchar(combinedAlpha() * 255.0f));
             cache.release_surface(srcBitmap);
         } else {
@@ -502,8 +783,12 @@ void renderer::CompLayer::renderHelper(VPainter *    painter,
 {
     VRle mask;
     if (mLayerMask) {
-        mask = mLayerMask->maskRle(painter->clipBoundingRect());
-        if (!inheritMask.empty()) mask = mask & inheritMask;
+        mask = mLayerMask->maskRle();
+        if (!inheritMask.empty()) {
+            mMaskRle.clone(mask);
+            mMaskRle &= inheritMask;
+            mask = mMaskRle;
+        }
         // if resulting mask is empty then return.
         if (mask.empty()) return;
     } else {
@@ -517,6 +802,7 @@ void renderer::CompLayer::renderHelper(VPainter *    painter,
 
     renderer::Layer *matte = nullptr;
     for (const auto &layer : mLayers) {
+        if (!FrameGuard::check()) return;
         if (layer->hasMatte()) {
             matte = layer;
         } else {
@@ -540,19 +826,28 @@ void renderer::CompLayer::renderMatteLayer(VPainter *painter, const VRle &mask,
                                            renderer::Layer *src,
                                            SurfaceCache &   cache)
 {
-    VSize size = painter->clipBoundingRect().size();
+    vTraceSpan("CompLayer::renderMatteLayer");
+    // only the area covered by the layer and, unless the matte is inverted,
+    // by the matte source can be visible.
+    VRect bounds = layer->renderBounds();
+    if (layer->matteType() == model::MatteType::Alpha ||
+        layer->matteType() == model::MatteType::Luma)
+        bounds = bounds & src->renderBounds();
+    VRect area = offscreenArea(painter->clipBoundingRect(), bounds);
+    if (area.empty()) return;
+
     // Decide if we can use fast matte.
     // 1. draw src layer to matte buffer
     VPainter srcPainter;
-    VBitmap  srcBitmap = cache.make_surface(size.width(), size.height());
-    srcPainter.begin(&srcBitmap);
+    VBitmap  srcBitmap = cache.make_surface(area.width(), area.height());
+    srcPainter.begin(&srcBitmap, area);
     src->render(&srcPainter, mask, matteRle, cache);
     srcPainter.end();
 
     // 2. draw layer to layer buffer
     VPainter layerPainter;
-    VBitmap  layerBitmap = cache.make_surface(size.width(), size.height());
-    layerPainter.begin(&layerBitmap);
+    VBitmap  layerBitmap = cache.make_surface(area.width(), area.height());
+    layerPainter.begin(&layerBitmap, area);
     layer->render(&layerPainter, mask, matteRle, cache);
 
     // 2.1update composition mode
@@ -578,10 +873,10 @@ void renderer::CompLayer::renderMatteLayer(VPainter *painter, const VRle &mask,
     }
 
     // 2.3 draw src buffer as mask
-    layerPainter.drawBitmap(VPoint(), srcBitmap);
+    layerPainter.drawBitmap(area, srcBitmap, VRect(VPoint(), area.size()));
     layerPainter.end();
     // 3. draw the result buffer into painter
-    painter->drawBitmap(VPoint(), layerBitmap);
+    painter->drawBitmap(area, layerBitmap, VRect(VPoint(), area.size()));
 
     cache.release_surface(srcBitmap);
     cache.release_surface(layerBitmap);
@@ -620,6 +915,7 @@ void renderer::CompLayer::updateContent()
     float alpha = combinedAlpha();
     if (complexContent()) alpha = 1;
     for (const auto &layer : mLayers) {
+        if (!FrameGuard::check()) return;
         layer->update(mappedFrame, combinedMatrix(), alpha);
     }
 }
@@ -631,6 +927,7 @@ void renderer::CompLayer::preprocessStage(const VRect &clip)
 
     renderer::Layer *matte = nullptr;
     for (const auto &layer : mLayers) {
+        if (!FrameGuard::check()) return;
         if (layer->hasMatte()) {
             matte = layer;
         } else {
@@ -818,7 +1115,14 @@ void renderer::ShapeLayer::preprocessStage(const VRect &clip)
     mDrawableList.clear();
     mRoot->renderList(mDrawableList);
 
-    for (auto &drawable : mDrawableList) drawable->preprocess(clip);
+    size_t maxPoints = FrameGuard::maxPathPoints();
+    for (auto &drawable : mDrawableList) {
+        if (!FrameGuard::check()) return;
+        if (!drawable->preprocess(clip, maxPoints)) {
+            FrameGuard::fail(rlottie::RenderError::PathPoints);
+            return;
+        }
+    }
 }
 
 renderer::DrawableList renderer::ShapeLayer::renderList()
@@ -1166,6 +1470,9 @@ void renderer::Paint::updateRenderNode()
     }
 
     if (dirty) {
+        // the drawable keeps a reference to the last path if it was not
+        // rasterized, drop it so that the path is rebuilt in place.
+        mDrawable.mPath = VPath();
         mPath.reset();
         for (const auto &i : mPathItems) {
             i->finalPath(mPath);
@@ -1353,7 +1660,8 @@ void renderer::Trim::update()
     if (mData->type() == model::Trim::TrimType::Simultaneously) {
         for (auto &i : mPathItems) {
             mPathMesure.setRange(mCache.mSegment.start, mCache.mSegment.end);
-            i->updatePath(mPathMesure.trim(i->localPath()));
+            mPathMesure.trim(i->localPath(), i->pathOpResult());
+            i->updatePath(i->pathOpResult());
         }
     } else {  // model::Trim::TrimType::Individually
         float totalLength = 0.0;
@@ -1388,7 +1696,8 @@ void renderer::Trim::update()
                     float local_end = curLen + len < end ? len : end - curLen;
                     local_end /= len;
                     mPathMesure.setRange(local_start, local_end);
-                    i->updatePath(mPathMesure.trim(i->localPath()));
+                    mPathMesure.trim(i->localPath(), i->pathOpResult());
+                    i->updatePath(i->pathOpResult());
                     curLen += len;
                 }
             }
@@ -28,6 +28,7 @@
 #include "rlottiecommon.h"
 #include "varenaalloc.h"
 #include "vdrawable.h"
+#include "velapsedtimer.h"
 #include "vmatrix.h"
 #include "vpainter.h"
 #include "vpath.h"
@@ -84,27 +85,73 @@ enum class DirtyFlagBit : uchar {
 };
 typedef vFlag<DirtyFlagBit> DirtyFlag;
 
+/*
+ * Offscreen surfaces for matte and precomp layers. make_surface() returns
+ * a surface of at least the requested size, the surfaces are allocated in
+ * size classes so that one of them serves the following requests of a
+ * similar size. The memory held by the idle surfaces of all the caches is
+ * limited by configureSurfaceCacheSize().
+ */
 class SurfaceCache {
 public:
     SurfaceCache() { mCache.reserve(10); }
+    ~SurfaceCache();
 
     VBitmap make_surface(
         size_t width, size_t height,
-        VBitmap::Format format = VBitmap::Format::ARGB32_Premultiplied)
-    {
-        if (mCache.empty()) return {width, height, format};
+        VBitmap::Format format = VBitmap::Format::ARGB32_Premultiplied);
 
-        auto surface = mCache.back();
-        surface.reset(width, height, format);
-
-        mCache.pop_back();
-        return surface;
-    }
+    void release_surface(VBitmap &surface);
 
-    void release_surface(VBitmap &surface) { mCache.push_back(surface); }
+    // memory held by the surfaces of this cache, in use or idle.
+    size_t bytes() const { return mInUseBytes + mCachedBytes; }
+    size_t peakBytes() const { return mPeakBytes; }
 
 private:
     std::vector<VBitmap> mCache;
+    size_t               mInUseBytes{0};
+    size_t               mCachedBytes{0};
+    size_t               mPeakBytes{0};
+};
+
+void                       configureSurfaceCacheSize(size_t cacheSize);
+rlottie::SurfaceCacheStats surfaceCacheStats();
+
+void                  configureRenderLimits(const rlottie::RenderLimits &limits);
+rlottie::RenderLimits renderLimits();
+
+void configureRenderPhaseHook(rlottie::RenderPhaseHook hook);
+
+/*
+ * Checks the frame being rendered on this thread against the limits of
+ * its Animation. The layers ask check() before updating, preprocessing or
+ * drawing each child, once a limit is exceeded the rest of the frame is
+ * skipped.
+ */
+class FrameGuard {
+public:
+    explicit FrameGuard(const rlottie::RenderLimits &limits);
+    ~FrameGuard();
+    FrameGuard(const FrameGuard &) = delete;
+    FrameGuard &operator=(const FrameGuard &) = delete;
+
+    bool                 ok() const { return mError == rlottie::RenderError::None; }
+    rlottie::RenderError error() const { return mError; }
+
+    static bool check();
+    // limit on the points of a path after dashing, 0 if there is none.
+    static size_t maxPathPoints();
+    // false, and fails the frame, if a path of 'points' points exceeds it.
+    static bool checkPath(size_t points);
+    static void fail(rlottie::RenderError error);
+
+private:
+    static thread_local FrameGuard *sCurrent;
+    FrameGuard *                    mPrevious{nullptr};
+    rlottie::RenderLimits           mLimits;
+    rlottie::RenderError            mError{rlottie::RenderError::None};
+    VElapsedTimer                   mTimer;
+    bool                            mLimited{false};
 };
 
 class Drawable : public VDrawable {
@@ -135,6 +182,7 @@ public:
     void update(const VMatrix &matrix);
     void preprocess(const VRect &clip);
     VRle rle(const VRle &mask);
+    VRect bounds() { return mRasterizer.rle().boundingRect(); }
 
 public:
     VSize       mSize;
@@ -171,12 +219,13 @@ public:
     void update(int frameNo, const VMatrix &parentMatrix, float parentAlpha,
                 const DirtyFlag &flag);
     bool isStatic() const { return mStatic; }
-    VRle maskRle(const VRect &clipRect);
+    VRle maskRle();
     void preprocess(const VRect &clip);
 
 public:
     std::vector<Mask> mMasks;
     VRle              mRle;
+    VRect             mClip;
     bool              mStatic{true};
     bool              mDirty{true};
 };
@@ -192,8 +241,12 @@ public:
     const LOTLayerNode *renderTree() const;
     bool                render(const rlottie::Surface &surface);
     void                setValue(const std::string &keypath, LOTVariant &value);
+    const rlottie::RenderTimings &timings() const { return mTimings; }
+    void resetTimings() { mTimings = rlottie::RenderTimings(); }
+    void memoryUsage(rlottie::MemoryUsage &usage) const;
 
 private:
+    rlottie::RenderTimings              mTimings;
     SurfaceCache                        mSurfaceCache;
     VBitmap                             mSurface;
     VMatrix                             mScaleMatrix;
@@ -220,6 +273,8 @@ public:
     VMatrix      matrix(int frameNo) const;
     void         preprocess(const VRect &clip);
     virtual DrawableList renderList() { return {}; }
+    // area the layer draws into, valid after preprocess().
+    virtual VRect        renderBounds();
     virtual void         render(VPainter *painter, const VRle &mask,
                                 const VRle &matteRle, SurfaceCache &cache);
     bool                 hasMatte()
@@ -262,12 +317,14 @@ protected:
     DirtyFlag                  mDirtyFlag{DirtyFlagBit::All};
     bool                       mComplexContent{false};
     std::unique_ptr<CApiData>  mCApiData;
+    VRle                       mMaskRle;  // reused for the combined mask
 };
 
 class CompLayer : public Layer {
 public:
     explicit CompLayer(model::Layer *layerData, VArenaAlloc *allocator);
 
+    VRect renderBounds() final;
     void render(VPainter *painter, const VRle &mask, const VRle &matteRle,
                 SurfaceCache &cache) final;
     void buildLayerNode() final;
@@ -406,6 +463,9 @@ public:
         mTemp = path;
         mDirtyPath = true;
     }
+    // storage for the result of a path operation, kept across frames so
+    // that its memory gets reused.
+    VPath &      pathOpResult() { return mPathOpResult; }
     bool   staticPath() const { return mStaticPath; }
     void   setParent(Group *parent) { mParent = parent; }
     Group *parent() const { return mParent; }
@@ -426,6 +486,7 @@ private:
     Group *mParent{nullptr};
     VPath  mLocalPath;
     VPath  mTemp;
+    VPath  mPathOpResult;
     int    mFrameNo{-1};
     bool   mDirtyPath{true};
     bool   mStaticPath;
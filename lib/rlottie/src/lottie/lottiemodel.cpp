@@ -17,7 +17,10 @@
  */
 
 #include "lottiemodel.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <iterator>
 #include <stack>
 #include "vimageloader.h"
@@ -89,6 +92,62 @@ public:
 
 class LottieUpdateStatVisitor {
     model::Composition::Stats *stat;
+    uint16_t                   mMatteDepth{0};
+    uint16_t                   mMaskDepth{0};
+    uint16_t                   mPrecompDepth{0};
+    uint32_t                   mRepeaterCopies{1};
+
+    template <typename T>
+    void countKeyFrames(const model::Property<T> &prop)
+    {
+        if (!prop.isStatic())
+            stat->keyFrameCount += uint32_t(prop.animation().mKeyFrames.size());
+    }
+    void countKeyFrames(const model::Dash &dash)
+    {
+        for (const auto &elm : dash.mData) countKeyFrames(elm);
+    }
+    void countTransform(const model::Transform *transform)
+    {
+        auto data = transform ? transform->data() : nullptr;
+        if (!data) return;
+        countKeyFrames(data->mRotation);
+        countKeyFrames(data->mScale);
+        countKeyFrames(data->mPosition);
+        countKeyFrames(data->mAnchor);
+        countKeyFrames(data->mOpacity);
+        if (data->mExtra) {
+            countKeyFrames(data->mExtra->m3DRx);
+            countKeyFrames(data->mExtra->m3DRy);
+            countKeyFrames(data->mExtra->m3DRz);
+            countKeyFrames(data->mExtra->mSeparateX);
+            countKeyFrames(data->mExtra->mSeparateY);
+        }
+    }
+    // the gradient stops aren't counted, they can't be baked.
+    void countGradient(const model::Gradient *gradient)
+    {
+        countKeyFrames(gradient->mStartPoint);
+        countKeyFrames(gradient->mEndPoint);
+        countKeyFrames(gradient->mHighlightLength);
+        countKeyFrames(gradient->mHighlightAngle);
+        countKeyFrames(gradient->mOpacity);
+    }
+    void countPath(const model::Property<model::PathData> &prop)
+    {
+        countKeyFrames(prop);
+        if (prop.isStatic()) {
+            stat->dataBytes += prop.value().mPoints.capacity() * sizeof(VPointF);
+            return;
+        }
+        for (const auto &keyFrame : prop.animation().mKeyFrames) {
+            stat->dataBytes +=
+                sizeof(keyFrame) +
+                (keyFrame.mValue.mStartValue.mPoints.capacity() +
+                 keyFrame.mValue.mEndValue.mPoints.capacity()) *
+                    sizeof(VPointF);
+        }
+    }
 
 public:
     explicit LottieUpdateStatVisitor(model::Composition::Stats *s) : stat(s) {}
@@ -119,7 +178,36 @@ public:
         default:
             break;
         }
+
+        countTransform(layer->mTransform);
+        if (layer->mExtra) countKeyFrames(layer->mExtra->mTimeRemap);
+
+        // the depths count the offscreen passes a layer is rendered through.
+        bool matte = layer->mMatteType != model::MatteType::None;
+        bool mask = layer->hasMask() && layer->mExtra;
+        bool precomp = layer->precompLayer();
+        if (matte) {
+            stat->matteCount++;
+            mMatteDepth++;
+        }
+        if (mask) {
+            stat->maskCount += uint32_t(layer->mExtra->mMasks.size());
+            for (const auto &m : layer->mExtra->mMasks) {
+                countPath(m->mShape);
+                countKeyFrames(m->mOpacity);
+            }
+            mMaskDepth++;
+        }
+        if (precomp) mPrecompDepth++;
+        stat->maxMatteDepth = std::max(stat->maxMatteDepth, mMatteDepth);
+        stat->maxMaskDepth = std::max(stat->maxMaskDepth, mMaskDepth);
+        stat->maxPrecompDepth = std::max(stat->maxPrecompDepth, mPrecompDepth);
+
         visitChildren(layer);
+
+        if (matte) mMatteDepth--;
+        if (mask) mMaskDepth--;
+        if (precomp) mPrecompDepth--;
     }
     void visit(model::Object *obj)
     {
@@ -129,11 +217,107 @@ public:
             break;
         }
         case model::Object::Type::Repeater: {
-            visitChildren(static_cast<model::Repeater *>(obj)->content());
+            auto repeater = static_cast<model::Repeater *>(obj);
+            stat->repeaterCount++;
+            // the renderer builds the content once per copy.
+            uint32_t copies = mRepeaterCopies;
+            double   nested = double(copies) * repeater->mMaxCopies;
+            mRepeaterCopies =
+                !(nested < UINT32_MAX) ? UINT32_MAX
+                                     : std::max(uint32_t(nested), copies);
+            stat->maxRepeaterCopies =
+                std::max(stat->maxRepeaterCopies, mRepeaterCopies);
+            countKeyFrames(repeater->mCopies);
+            countKeyFrames(repeater->mOffset);
+            countKeyFrames(repeater->mTransform.mRotation);
+            countKeyFrames(repeater->mTransform.mScale);
+            countKeyFrames(repeater->mTransform.mPosition);
+            countKeyFrames(repeater->mTransform.mAnchor);
+            countKeyFrames(repeater->mTransform.mStartOpacity);
+            countKeyFrames(repeater->mTransform.mEndOpacity);
+            visitChildren(repeater->content());
+            mRepeaterCopies = copies;
             break;
         }
         case model::Object::Type::Group: {
-            visitChildren(static_cast<model::Group *>(obj));
+            auto group = static_cast<model::Group *>(obj);
+            countTransform(group->mTransform);
+            visitChildren(group);
+            break;
+        }
+        case model::Object::Type::Transform: {
+            countTransform(static_cast<model::Transform *>(obj));
+            break;
+        }
+        case model::Object::Type::Path: {
+            stat->shapeCount++;
+            countPath(static_cast<model::Path *>(obj)->mShape);
+            break;
+        }
+        case model::Object::Type::Rect: {
+            auto rect = static_cast<model::Rect *>(obj);
+            stat->shapeCount++;
+            countKeyFrames(rect->mPos);
+            countKeyFrames(rect->mSize);
+            countKeyFrames(rect->mRound);
+            break;
+        }
+        case model::Object::Type::Ellipse: {
+            auto ellipse = static_cast<model::Ellipse *>(obj);
+            stat->shapeCount++;
+            countKeyFrames(ellipse->mPos);
+            countKeyFrames(ellipse->mSize);
+            break;
+        }
+        case model::Object::Type::Polystar: {
+            auto polystar = static_cast<model::Polystar *>(obj);
+            stat->shapeCount++;
+            countKeyFrames(polystar->mPos);
+            countKeyFrames(polystar->mPointCount);
+            countKeyFrames(polystar->mInnerRadius);
+            countKeyFrames(polystar->mOuterRadius);
+            countKeyFrames(polystar->mInnerRoundness);
+            countKeyFrames(polystar->mOuterRoundness);
+            countKeyFrames(polystar->mRotation);
+            break;
+        }
+        case model::Object::Type::Fill: {
+            auto fill = static_cast<model::Fill *>(obj);
+            stat->fillCount++;
+            countKeyFrames(fill->mColor);
+            countKeyFrames(fill->mOpacity);
+            break;
+        }
+        case model::Object::Type::GFill: {
+            stat->fillCount++;
+            stat->gradientCount++;
+            countGradient(static_cast<model::Gradient *>(obj));
+            break;
+        }
+        case model::Object::Type::Stroke: {
+            auto stroke = static_cast<model::Stroke *>(obj);
+            stat->strokeCount++;
+            countKeyFrames(stroke->mColor);
+            countKeyFrames(stroke->mOpacity);
+            countKeyFrames(stroke->mWidth);
+            countKeyFrames(stroke->mDash);
+            break;
+        }
+        case model::Object::Type::GStroke: {
+            auto stroke = static_cast<model::GradientStroke *>(obj);
+            stat->strokeCount++;
+            stat->gradientCount++;
+            countGradient(stroke);
+            countKeyFrames(stroke->mWidth);
+            countKeyFrames(stroke->mDash);
+            break;
+        }
+        case model::Object::Type::Trim: {
+            auto trim = static_cast<model::Trim *>(obj);
+            stat->trimCount++;
+            countKeyFrames(trim->mStart);
+            countKeyFrames(trim->mEnd);
+            countKeyFrames(trim->mOffset);
             break;
         }
         default:
@@ -152,6 +336,74 @@ void model::Composition::updateStats()
 {
     LottieUpdateStatVisitor visitor(&mStats);
     visitor.visit(mRootLayer);
+
+    // the memory of the float, point and color keyframes, counted once
+    // however often a precomp is referenced.
+    auto countBytes = [this](const auto &list) {
+        for (const auto &prop : list) {
+            mStats.dataBytes +=
+                prop->mKeyFrames.capacity() * sizeof(prop->mKeyFrames[0]);
+        }
+    };
+    countBytes(mAnimated.mFloat);
+    countBytes(mAnimated.mPoint);
+    countBytes(mAnimated.mColor);
+
+    for (const auto &asset : mAssets) {
+        if (asset.second->mAssetType == model::Asset::Type::Image)
+            mStats.imageAssetCount++;
+    }
+
+    mStats.cost = estimatedCost();
+}
+
+/*
+ * Estimated time in ms to render all the frames at 512x512 and encode them
+ * losslessly, a power law of the counts fitted to the conversion time of
+ * the example/resource and examples/1762 animations (median error within a
+ * factor of 2.1, 2.3 leave-one-out). The encoding dominates, and depends on the pixels more
+ * than on the model, so it is only good enough to order the animations by
+ * cost.
+ */
+float model::Composition::estimatedCost() const
+{
+    auto term = [](double count, double exponent) {
+        return std::pow(1 + count, exponent);
+    };
+    return float(2.57 * term(double(totalFrame()), 1.04) *
+                 term(mStats.shapeCount, 0.26) *
+                 term(mStats.gradientCount, 0.34) *
+                 term(mStats.keyFrameCount, 0.228) *
+                 term(mStats.repeaterCount, 0.18) *
+                 term(mStats.imageAssetCount, 4.7));
+}
+
+/*
+ * Bake the animated properties until the budget runs out, the ones that
+ * don't fit keep being evaluated from their keyframes.
+ */
+size_t model::Composition::bakeProperties(size_t budget)
+{
+    size_t remaining = budget;
+    auto   bake = [&remaining](const auto &list) {
+        for (auto obj : list) obj->bake(remaining);
+    };
+
+    bake(mAnimated.mFloat);
+    bake(mAnimated.mPoint);
+    bake(mAnimated.mColor);
+
+    mBakedBytes += budget - remaining;
+    return budget - remaining;
+}
+
+/*
+ * The model objects live in the arena, only the path points and the
+ * keyframes are counted of the memory they own.
+ */
+size_t model::Composition::memoryUsage() const
+{
+    return mArenaAlloc.heapBytes() + mStats.dataBytes + mBakedBytes;
 }
 
 VMatrix model::Repeater::Transform::matrix(int frameNo, float multiplier) const
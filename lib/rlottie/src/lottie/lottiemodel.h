@@ -213,6 +213,11 @@ class DynamicProperty {
 public:
     T value(int frameNo) const
     {
+        if (!mBaked.empty()) {
+            auto index = size_t(frameNo - mBakedFrom);
+            if (index < mBaked.size()) return mBaked[index];
+        }
+
         if (mKeyFrames.front().mStartFrame >= frameNo)
             return mKeyFrames.front().mValue.mStartValue;
         if (mKeyFrames.back().mEndFrame <= frameNo)
@@ -247,8 +252,38 @@ public:
                  (last < prevFrame && last < curFrame));
     }
 
+    /*
+     * Evaluates the value at every integer frame between the first and the
+     * last keyframe so that value() becomes a lookup, outside of that range
+     * the value is constant anyway. returns false if the values don't fit
+     * in the remaining budget.
+     */
+    bool bake(size_t &budget)
+    {
+        if (!mBaked.empty()) return true;
+
+        double first = std::ceil(mKeyFrames.front().mStartFrame);
+        double last = std::floor(mKeyFrames.back().mEndFrame);
+        if (last < first) return true;
+
+        double count = last - first + 1;
+        if (count * sizeof(T) > budget) return false;
+
+        std::vector<T> baked;
+        baked.reserve(size_t(count));
+        for (int frameNo = int(first); frameNo <= int(last); frameNo++)
+            baked.push_back(value(frameNo));
+
+        budget -= baked.size() * sizeof(T);
+        mBakedFrom = int(first);
+        mBaked = std::move(baked);
+        return true;
+    }
+
 public:
     std::vector<KeyFrame<T>> mKeyFrames;
+    std::vector<T>           mBaked;
+    int                      mBakedFrom{0};
 };
 
 template <typename T>
@@ -516,6 +551,9 @@ public:
     VSize  size() const { return mSize; }
     void   processRepeaterObjects();
     void   updateStats();
+    float  estimatedCost() const;
+    size_t bakeProperties(size_t budget);
+    size_t memoryUsage() const;
 
 public:
     struct Stats {
@@ -524,6 +562,37 @@ public:
         uint16_t shapeLayerCount{0};
         uint16_t imageLayerCount{0};
         uint16_t nullLayerCount{0};
+        uint32_t shapeCount{0};
+        uint32_t fillCount{0};
+        uint32_t strokeCount{0};
+        uint32_t gradientCount{0};
+        uint32_t trimCount{0};
+        uint32_t repeaterCount{0};
+        uint32_t maskCount{0};
+        uint32_t matteCount{0};
+        uint32_t keyFrameCount{0};
+        uint32_t imageAssetCount{0};
+        uint16_t maxMatteDepth{0};
+        uint16_t maxMaskDepth{0};
+        uint16_t maxPrecompDepth{0};
+        uint32_t maxRepeaterCopies{0};  // nested copies, saturated
+        float    cost{0};
+        size_t   dataBytes{0};  // keyframes and path points
+    };
+
+    // animated properties which can be baked, collected by the parser.
+    struct AnimatedProperties {
+        void add(DynamicProperty<float> *obj) { mFloat.push_back(obj); }
+        void add(DynamicProperty<VPointF> *obj) { mPoint.push_back(obj); }
+        void add(DynamicProperty<Color> *obj) { mColor.push_back(obj); }
+        template <typename T>
+        void add(DynamicProperty<T> *)
+        {
+        }
+
+        std::vector<DynamicProperty<float> *>   mFloat;
+        std::vector<DynamicProperty<VPointF> *> mPoint;
+        std::vector<DynamicProperty<Color> *>   mColor;
     };
 
 public:
@@ -539,6 +608,8 @@ public:
     std::vector<Marker> mMarkers;
     VArenaAlloc         mArenaAlloc{2048};
     Stats               mStats;
+    AnimatedProperties  mAnimated;
+    size_t              mBakedBytes{0};
 };
 
 class Transform : public Object {
@@ -591,6 +662,8 @@ public:
         if (isStatic()) return impl.mStaticData.mOpacity;
         return impl.mData->opacity(frameNo);
     }
+    // the animated properties, null once folded into a static matrix.
+    const Data *data() const { return isStatic() ? nullptr : impl.mData; }
     Transform(const Transform &) = delete;
     Transform(Transform &&) = delete;
     Transform &operator=(Transform &) = delete;
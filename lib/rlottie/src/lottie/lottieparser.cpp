@@ -50,8 +50,33 @@
 // the parse.
 
 #include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "lottiemodel.h"
+
+// let rapidjson skip whitespace and scan strings 16 bytes at a time. The
+// aligned loads may read past the end of the json, which is harmless but
+// trips AddressSanitizer.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define LOTTIE_PARSER_ASAN
+#endif
+#elif defined(__SANITIZE_ADDRESS__)
+#define LOTTIE_PARSER_ASAN
+#endif
+
+#if !defined(LOTTIE_PARSER_ASAN)
+#if defined(__SSE4_2__)
+#define RAPIDJSON_SSE42
+#elif defined(__SSE2__)
+#define RAPIDJSON_SSE2
+#elif defined(__ARM_NEON__)
+#define RAPIDJSON_NEON
+#endif
+#endif
+
 #include "rapidjson/document.h"
 
 RAPIDJSON_DIAG_PUSH
@@ -63,6 +88,28 @@ using namespace rapidjson;
 
 using namespace rlottie::internal;
 
+/*
+ * Lottie keys are short ascii identifiers ("ty", "ks", "nm" ...), packing up
+ * to 8 characters in a integer gives a collision free hash for all of them so
+ * the attribute lookup can be a switch instead of a chain of strcmp().
+ * The few longer keys ("masksProperties", "fillEnabled") use FNV-1a with the
+ * top bit set, which the packed form of a ascii key never has.
+ */
+static constexpr uint64_t keyHash(const char *str)
+{
+    uint64_t packed = 0;
+    for (size_t i = 0; str[i]; i++) {
+        if (i == 8) {
+            uint64_t hash = 14695981039346656037ull;
+            for (const char *p = str; *p; p++)
+                hash = (hash ^ uint8_t(*p)) * 1099511628211ull;
+            return hash | (uint64_t(1) << 63);
+        }
+        packed = (packed << 8) | uint8_t(str[i]);
+    }
+    return packed;
+}
+
 class LookaheadParserHandler {
 public:
     bool Null()
@@ -174,6 +221,7 @@ public:
           mColorFilter(std::move(filter)),
           mDirPath(std::move(dir_path))
     {
+        collectAssetRefs(str);
     }
     bool VerifyType();
     bool ParseNext();
@@ -266,8 +314,15 @@ public:
     model::Color toColor(const char *str);
 
     void resolveLayerRefs();
+    void breakPrecompCycles();
+    size_t precompHeight(model::Asset *asset, size_t depth,
+                         std::unordered_map<model::Asset *, size_t> &heights);
     void parsePathInfo();
 
+    void collectAssetRefs(const char *str);
+    bool isAssetReferenced(const std::string &refId) const;
+    bool skipLayerContent(const model::Layer *layer, bool rangeKnown) const;
+
 private:
     model::ColorFilter mColorFilter;
     struct {
@@ -349,6 +404,10 @@ protected:
     model::Composition *                             compRef{nullptr};
     model::Layer *                                   curLayerRef{nullptr};
     std::vector<model::Layer *>                      mLayersToUpdate;
+    std::unordered_set<std::string>                  mAssetRefs;
+    bool                                             mSkipUnusedAssets{true};
+    bool                                             mParsingRootLayers{false};
+    bool                                             mCompRangeKnown{false};
     std::string                                      mDirPath;
     void                                             SkipOut(int depth);
 };
@@ -614,6 +673,59 @@ model::BlendMode LottieParserImpl::getBlendMode()
     return mode;
 }
 
+/*
+ * Unused precomp and image assets are common in stickers exported with a
+ * big library, building the model for them only to drop it later is
+ * wasted work. So before parsing, do a quick scan over the raw json for all
+ * "refId" values, assets that are never referenced are skipped in
+ * parseAsset(). The scan must run before the in-situ parser rewrites the
+ * buffer. A false positive only means the asset gets parsed as before.
+ */
+void LottieParserImpl::collectAssetRefs(const char *str)
+{
+    static constexpr char   tag[] = "\"refId\"";
+    static constexpr size_t tagLen = sizeof(tag) - 1;
+
+    while ((str = strstr(str, tag))) {
+        str += tagLen;
+        while (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r' ||
+               *str == ':')
+            str++;
+        if (*str != '"') continue;
+
+        const char *begin = ++str;
+        while (*str && *str != '"' && *str != '\\') str++;
+        if (*str != '"') {
+            // escaped or broken id, can't match it against the asset id.
+            mSkipUnusedAssets = false;
+            return;
+        }
+        mAssetRefs.emplace(begin, str - begin);
+    }
+}
+
+bool LottieParserImpl::isAssetReferenced(const std::string &refId) const
+{
+    return !mSkipUnusedAssets || mAssetRefs.count(refId);
+}
+
+/*
+ * The content of a hidden layer is released anyway and a root layer whose
+ * in/out range doesn't overlap the composition is never drawn, so their
+ * shapes can be skipped when that is already known at the time the
+ * "shapes" key is reached.
+ */
+bool LottieParserImpl::skipLayerContent(const model::Layer *layer,
+                                        bool                rangeKnown) const
+{
+    if (layer->hidden()) return true;
+
+    if (!rangeKnown || !mParsingRootLayers || !mCompRangeKnown) return false;
+
+    return layer->mOutFrame <= compRef->mStartFrame ||
+           layer->mInFrame >= compRef->mEndFrame;
+}
+
 void LottieParserImpl::resolveLayerRefs()
 {
     for (const auto &layer : mLayersToUpdate) {
@@ -630,6 +742,55 @@ void LottieParserImpl::resolveLayerRefs()
     }
 }
 
+/*
+ * Precomps which reference themselves, directly or through other precomps,
+ * would be expanded forever by the renderer, and very deep ones overflow
+ * its stack. Such references are left empty, which bounds the nesting of
+ * precomp layers by MaxPrecompNesting.
+ */
+static constexpr size_t MaxPrecompNesting = 128;
+static constexpr size_t PrecompInProgress = SIZE_MAX;
+
+size_t LottieParserImpl::precompHeight(
+    model::Asset *asset, size_t depth,
+    std::unordered_map<model::Asset *, size_t> &heights)
+{
+    auto search = heights.find(asset);
+    if (search != heights.end()) return search->second;
+
+    heights[asset] = PrecompInProgress;
+    size_t height = 0;
+    for (auto object : asset->mLayers) {
+        auto layer = static_cast<model::Layer *>(object);
+        if (!layer->precompLayer() || layer->mChildren.empty()) continue;
+
+        auto ref = compRef->mAssets.find(layer->mExtra->mPreCompRefId);
+        if (ref == compRef->mAssets.end()) continue;
+
+        size_t childHeight = depth < MaxPrecompNesting
+                                 ? precompHeight(ref->second, depth + 1, heights)
+                                 : PrecompInProgress;
+        if (childHeight >= MaxPrecompNesting) {
+            vWarning << "precomp " << asset->mRefId
+                     << " nests too deep or references itself";
+            layer->mChildren.clear();
+            continue;
+        }
+        height = std::max(height, childHeight + 1);
+    }
+    heights[asset] = height;
+    return height;
+}
+
+void LottieParserImpl::breakPrecompCycles()
+{
+    std::unordered_map<model::Asset *, size_t> heights;
+    for (const auto &asset : compRef->mAssets) {
+        if (asset.second->mAssetType == model::Asset::Type::Precomp)
+            precompHeight(asset.second, 0, heights);
+    }
+}
+
 void LottieParserImpl::parseComposition()
 {
     RAPIDJSON_ASSERT(PeekType() == kObjectType);
@@ -638,36 +799,53 @@ void LottieParserImpl::parseComposition()
         std::make_shared<model::Composition>();
     model::Composition *comp = sharedComposition.get();
     compRef = comp;
+    bool hasStartFrame = false;
+    bool hasEndFrame = false;
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "v")) {
+        switch (keyHash(key)) {
+        case keyHash("v"):
             RAPIDJSON_ASSERT(PeekType() == kStringType);
             comp->mVersion = std::string(GetString());
-        } else if (0 == strcmp(key, "w")) {
+            break;
+        case keyHash("w"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             comp->mSize.setWidth(GetInt());
-        } else if (0 == strcmp(key, "h")) {
+            break;
+        case keyHash("h"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             comp->mSize.setHeight(GetInt());
-        } else if (0 == strcmp(key, "ip")) {
+            break;
+        case keyHash("ip"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             comp->mStartFrame = GetDouble();
-        } else if (0 == strcmp(key, "op")) {
+            hasStartFrame = true;
+            mCompRangeKnown = hasEndFrame;
+            break;
+        case keyHash("op"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             comp->mEndFrame = GetDouble();
-        } else if (0 == strcmp(key, "fr")) {
+            hasEndFrame = true;
+            mCompRangeKnown = hasStartFrame;
+            break;
+        case keyHash("fr"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             comp->mFrameRate = GetDouble();
-        } else if (0 == strcmp(key, "assets")) {
+            break;
+        case keyHash("assets"):
             parseAssets(comp);
-        } else if (0 == strcmp(key, "layers")) {
+            break;
+        case keyHash("layers"):
             parseLayers(comp);
-        } else if (0 == strcmp(key, "markers")) {
+            break;
+        case keyHash("markers"):
             parseMarkers();
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vWarning << "Composition Attribute Skipped : " << key;
 #endif
             Skip(key);
+            break;
         }
     }
 
@@ -680,6 +858,7 @@ void LottieParserImpl::parseComposition()
     }
 
     resolveLayerRefs();
+    breakPrecompCycles();
     comp->setStatic(comp->mRootLayer->isStatic());
     comp->mRootLayer->mInFrame = comp->mStartFrame;
     comp->mRootLayer->mOutFrame = comp->mEndFrame;
@@ -695,21 +874,25 @@ void LottieParserImpl::parseMarker()
     int         timeframe{0};
     int         duration{0};
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "cm")) {
+        switch (keyHash(key)) {
+        case keyHash("cm"):
             RAPIDJSON_ASSERT(PeekType() == kStringType);
             comment = std::string(GetString());
-        } else if (0 == strcmp(key, "tm")) {
+            break;
+        case keyHash("tm"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             timeframe = GetDouble();
-        } else if (0 == strcmp(key, "dr")) {
+            break;
+        case keyHash("dr"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             duration = GetDouble();
-
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vWarning << "Marker Attribute Skipped : " << key;
 #endif
             Skip(key);
+            break;
         }
     }
     compRef->mMarkers.emplace_back(std::move(comment), timeframe,
@@ -732,7 +915,7 @@ void LottieParserImpl::parseAssets(model::Composition *composition)
     EnterArray();
     while (NextArrayValue()) {
         auto asset = parseAsset();
-        composition->mAssets[asset->mRefId] = asset;
+        if (asset) composition->mAssets[asset->mRefId] = asset;
     }
     // update the precomp layers with the actual layer object
 }
@@ -812,29 +995,40 @@ model::Asset *LottieParserImpl::parseAsset()
     bool        embededResource = false;
     EnterObject();
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "w")) {
+        switch (keyHash(key)) {
+        case keyHash("w"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             asset->mWidth = GetInt();
-        } else if (0 == strcmp(key, "h")) {
+            break;
+        case keyHash("h"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             asset->mHeight = GetInt();
-        } else if (0 == strcmp(key, "p")) { /* image name */
+            break;
+        case keyHash("p"): /* image name */
             asset->mAssetType = model::Asset::Type::Image;
             RAPIDJSON_ASSERT(PeekType() == kStringType);
             filename = std::string(GetString());
-        } else if (0 == strcmp(key, "u")) { /* relative image path */
+            break;
+        case keyHash("u"): /* relative image path */
             RAPIDJSON_ASSERT(PeekType() == kStringType);
             relativePath = std::string(GetString());
-        } else if (0 == strcmp(key, "e")) { /* relative image path */
+            break;
+        case keyHash("e"): /* relative image path */
             embededResource = GetInt();
-        } else if (0 == strcmp(key, "id")) { /* reference id*/
+            break;
+        case keyHash("id"): /* reference id*/
             if (PeekType() == kStringType) {
                 asset->mRefId = std::string(GetString());
             } else {
                 RAPIDJSON_ASSERT(PeekType() == kNumberType);
                 asset->mRefId = toString(GetInt());
             }
-        } else if (0 == strcmp(key, "layers")) {
+            if (!isAssetReferenced(asset->mRefId)) {
+                SkipObject();
+                return nullptr;
+            }
+            break;
+        case keyHash("layers"): {
             asset->mAssetType = model::Asset::Type::Precomp;
             RAPIDJSON_ASSERT(PeekType() == kArrayType);
             EnterArray();
@@ -847,11 +1041,14 @@ model::Asset *LottieParserImpl::parseAsset()
                 }
             }
             asset->setStatic(staticFlag);
-        } else {
+            break;
+        }
+        default:
 #ifdef DEBUG_PARSER
             vWarning << "Asset Attribute Skipped : " << key;
 #endif
             Skip(key);
+            break;
         }
     }
 
@@ -877,6 +1074,7 @@ void LottieParserImpl::parseLayers(model::Composition *comp)
     bool staticFlag = true;
     RAPIDJSON_ASSERT(PeekType() == kArrayType);
     EnterArray();
+    mParsingRootLayers = true;
     while (NextArrayValue()) {
         auto layer = parseLayer();
         if (layer) {
@@ -884,6 +1082,7 @@ void LottieParserImpl::parseLayers(model::Composition *comp)
             comp->mRootLayer->mChildren.push_back(layer);
         }
     }
+    mParsingRootLayers = false;
     comp->mRootLayer->setStatic(staticFlag);
 }
 
@@ -972,77 +1171,111 @@ model::Layer *LottieParserImpl::parseLayer()
     model::Layer *layer = allocator().make<model::Layer>();
     curLayerRef = layer;
     bool ddd = true;
+    bool hasInFrame = false;
+    bool hasOutFrame = false;
     EnterObject();
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "ty")) { /* Type of layer*/
+        switch (keyHash(key)) {
+        case keyHash("ty"): /* Type of layer*/
             layer->mLayerType = getLayerType();
-        } else if (0 == strcmp(key, "nm")) { /*Layer name*/
+            break;
+        case keyHash("nm"): /*Layer name*/
             RAPIDJSON_ASSERT(PeekType() == kStringType);
             layer->setName(GetString());
-        } else if (0 == strcmp(key, "ind")) { /*Layer index in AE. Used for
-                                                 parenting and expressions.*/
+            break;
+        case keyHash("ind"): /*Layer index in AE. Used for
+                                parenting and expressions.*/
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             layer->mId = GetInt();
-        } else if (0 == strcmp(key, "ddd")) { /*3d layer */
+            break;
+        case keyHash("ddd"): /*3d layer */
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             ddd = GetInt();
-        } else if (0 ==
-                   strcmp(key,
-                          "parent")) { /*Layer Parent. Uses "ind" of parent.*/
+            break;
+        case keyHash("parent"): /*Layer Parent. Uses "ind" of parent.*/
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             layer->mParentId = GetInt();
-        } else if (0 == strcmp(key, "refId")) { /*preComp Layer reference id*/
+            break;
+        case keyHash("refId"): /*preComp Layer reference id*/
             RAPIDJSON_ASSERT(PeekType() == kStringType);
             layer->extra()->mPreCompRefId = std::string(GetString());
             layer->mHasGradient = true;
             mLayersToUpdate.push_back(layer);
-        } else if (0 == strcmp(key, "sr")) {  // "Layer Time Stretching"
+            break;
+        case keyHash("sr"): // "Layer Time Stretching"
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             layer->mTimeStreatch = GetDouble();
-        } else if (0 == strcmp(key, "tm")) {  // time remapping
+            break;
+        case keyHash("tm"): // time remapping
             parseProperty(layer->extra()->mTimeRemap);
-        } else if (0 == strcmp(key, "ip")) {
+            break;
+        case keyHash("ip"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             layer->mInFrame = std::lround(GetDouble());
-        } else if (0 == strcmp(key, "op")) {
+            hasInFrame = true;
+            break;
+        case keyHash("op"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             layer->mOutFrame = std::lround(GetDouble());
-        } else if (0 == strcmp(key, "st")) {
+            hasOutFrame = true;
+            break;
+        case keyHash("st"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             layer->mStartFrame = GetDouble();
-        } else if (0 == strcmp(key, "bm")) {
+            break;
+        case keyHash("bm"):
             layer->mBlendMode = getBlendMode();
-        } else if (0 == strcmp(key, "ks")) {
+            break;
+        case keyHash("ks"):
             RAPIDJSON_ASSERT(PeekType() == kObjectType);
             EnterObject();
             layer->mTransform = parseTransformObject(ddd);
-        } else if (0 == strcmp(key, "shapes")) {
-            parseShapesAttr(layer);
-        } else if (0 == strcmp(key, "w")) {
+            break;
+        case keyHash("shapes"):
+            if (skipLayerContent(layer, hasInFrame && hasOutFrame))
+                Skip(key);
+            else
+                parseShapesAttr(layer);
+            break;
+        case keyHash("w"):
             layer->mLayerSize.setWidth(GetInt());
-        } else if (0 == strcmp(key, "h")) {
+            break;
+        case keyHash("h"):
             layer->mLayerSize.setHeight(GetInt());
-        } else if (0 == strcmp(key, "sw")) {
+            break;
+        case keyHash("sw"):
             layer->mLayerSize.setWidth(GetInt());
-        } else if (0 == strcmp(key, "sh")) {
+            break;
+        case keyHash("sh"):
             layer->mLayerSize.setHeight(GetInt());
-        } else if (0 == strcmp(key, "sc")) {
+            break;
+        case keyHash("sc"):
             layer->extra()->mSolidColor = toColor(GetString());
-        } else if (0 == strcmp(key, "tt")) {
+            break;
+        case keyHash("tt"):
             layer->mMatteType = getMatteType();
-        } else if (0 == strcmp(key, "hasMask")) {
+            break;
+        case keyHash("hasMask"):
             layer->mHasMask = GetBool();
-        } else if (0 == strcmp(key, "masksProperties")) {
-            parseMaskProperty(layer);
-        } else if (0 == strcmp(key, "ao")) {
+            break;
+        case keyHash("masksProperties"):
+            if (layer->hidden())
+                Skip(key);
+            else
+                parseMaskProperty(layer);
+            break;
+        case keyHash("ao"):
             layer->mAutoOrient = GetInt();
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             layer->setHidden(GetBool());
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vWarning << "Layer Attribute Skipped : " << key;
 #endif
             Skip(key);
+            break;
         }
     }
 
@@ -1100,9 +1333,11 @@ model::Mask *LottieParserImpl::parseMaskObject()
     RAPIDJSON_ASSERT(PeekType() == kObjectType);
     EnterObject();
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "inv")) {
+        switch (keyHash(key)) {
+        case keyHash("inv"):
             obj->mInv = GetBool();
-        } else if (0 == strcmp(key, "mode")) {
+            break;
+        case keyHash("mode"): {
             const char *str = GetString();
             if (!str) {
                 obj->mMode = model::Mask::Mode::None;
@@ -1128,12 +1363,17 @@ model::Mask *LottieParserImpl::parseMaskObject()
                 obj->mMode = model::Mask::Mode::None;
                 break;
             }
-        } else if (0 == strcmp(key, "pt")) {
+            break;
+        }
+        case keyHash("pt"):
             parseShapeProperty(obj->mShape);
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        case keyHash("o"):
             parseProperty(obj->mOpacity);
-        } else {
+            break;
+        default:
             Skip(key);
+            break;
         }
     }
     obj->mIsStatic = obj->mShape.isStatic() && obj->mOpacity.isStatic();
@@ -1153,38 +1393,39 @@ model::Object *LottieParserImpl::parseObjectTypeAttr()
 {
     RAPIDJSON_ASSERT(PeekType() == kStringType);
     const char *type = GetString();
-    if (0 == strcmp(type, "gr")) {
+    switch (keyHash(type)) {
+    case keyHash("gr"):
         return parseGroupObject();
-    } else if (0 == strcmp(type, "rc")) {
+    case keyHash("rc"):
         return parseRectObject();
-    } else if (0 == strcmp(type, "el")) {
+    case keyHash("el"):
         return parseEllipseObject();
-    } else if (0 == strcmp(type, "tr")) {
+    case keyHash("tr"):
         return parseTransformObject();
-    } else if (0 == strcmp(type, "fl")) {
+    case keyHash("fl"):
         return parseFillObject();
-    } else if (0 == strcmp(type, "st")) {
+    case keyHash("st"):
         return parseStrokeObject();
-    } else if (0 == strcmp(type, "gf")) {
+    case keyHash("gf"):
         curLayerRef->mHasGradient = true;
         return parseGFillObject();
-    } else if (0 == strcmp(type, "gs")) {
+    case keyHash("gs"):
         curLayerRef->mHasGradient = true;
         return parseGStrokeObject();
-    } else if (0 == strcmp(type, "sh")) {
+    case keyHash("sh"):
         return parseShapeObject();
-    } else if (0 == strcmp(type, "sr")) {
+    case keyHash("sr"):
         return parsePolystarObject();
-    } else if (0 == strcmp(type, "tm")) {
+    case keyHash("tm"):
         curLayerRef->mHasPathOperator = true;
         return parseTrimObject();
-    } else if (0 == strcmp(type, "rp")) {
+    case keyHash("rp"):
         curLayerRef->mHasRepeater = true;
         return parseReapeaterObject();
-    } else if (0 == strcmp(type, "mm")) {
+    case keyHash("mm"):
         vWarning << "Merge Path is not supported yet";
         return nullptr;
-    } else {
+    default:
 #ifdef DEBUG_PARSER
         vDebug << "The Object Type not yet handled = " << type;
 #endif
@@ -1211,23 +1452,28 @@ model::Object *LottieParserImpl::parseGroupObject()
     auto group = allocator().make<model::Group>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             group->setName(GetString());
-        } else if (0 == strcmp(key, "it")) {
+            break;
+        case keyHash("it"):
             RAPIDJSON_ASSERT(PeekType() == kArrayType);
             EnterArray();
             while (NextArrayValue()) {
                 RAPIDJSON_ASSERT(PeekType() == kObjectType);
                 parseObject(group);
             }
-            if (group->mChildren.back()->type() ==
-                model::Object::Type::Transform) {
+            if (!group->mChildren.empty() &&
+                group->mChildren.back()->type() ==
+                    model::Object::Type::Transform) {
                 group->mTransform =
                     static_cast<model::Transform *>(group->mChildren.back());
                 group->mChildren.pop_back();
             }
-        } else {
+            break;
+        default:
             Skip(key);
+            break;
         }
     }
     bool staticFlag = true;
@@ -1250,20 +1496,28 @@ model::Rect *LottieParserImpl::parseRectObject()
     auto obj = allocator().make<model::Rect>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "p")) {
+            break;
+        case keyHash("p"):
             parseProperty(obj->mPos);
-        } else if (0 == strcmp(key, "s")) {
+            break;
+        case keyHash("s"):
             parseProperty(obj->mSize);
-        } else if (0 == strcmp(key, "r")) {
+            break;
+        case keyHash("r"):
             parseProperty(obj->mRound);
-        } else if (0 == strcmp(key, "d")) {
+            break;
+        case keyHash("d"):
             obj->mDirection = GetInt();
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
             Skip(key);
+            break;
         }
     }
     obj->setStatic(obj->mPos.isStatic() && obj->mSize.isStatic() &&
@@ -1279,18 +1533,25 @@ model::Ellipse *LottieParserImpl::parseEllipseObject()
     auto obj = allocator().make<model::Ellipse>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "p")) {
+            break;
+        case keyHash("p"):
             parseProperty(obj->mPos);
-        } else if (0 == strcmp(key, "s")) {
+            break;
+        case keyHash("s"):
             parseProperty(obj->mSize);
-        } else if (0 == strcmp(key, "d")) {
+            break;
+        case keyHash("d"):
             obj->mDirection = GetInt();
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
             Skip(key);
+            break;
         }
     }
     obj->setStatic(obj->mPos.isStatic() && obj->mSize.isStatic());
@@ -1305,19 +1566,25 @@ model::Path *LottieParserImpl::parseShapeObject()
     auto obj = allocator().make<model::Path>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "ks")) {
+            break;
+        case keyHash("ks"):
             parseShapeProperty(obj->mShape);
-        } else if (0 == strcmp(key, "d")) {
+            break;
+        case keyHash("d"):
             obj->mDirection = GetInt();
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vDebug << "Shape property ignored :" << key;
 #endif
             Skip(key);
+            break;
         }
     }
     obj->setStatic(obj->mShape.isStatic());
@@ -1333,36 +1600,50 @@ model::Polystar *LottieParserImpl::parsePolystarObject()
     auto obj = allocator().make<model::Polystar>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "p")) {
+            break;
+        case keyHash("p"):
             parseProperty(obj->mPos);
-        } else if (0 == strcmp(key, "pt")) {
+            break;
+        case keyHash("pt"):
             parseProperty(obj->mPointCount);
-        } else if (0 == strcmp(key, "ir")) {
+            break;
+        case keyHash("ir"):
             parseProperty(obj->mInnerRadius);
-        } else if (0 == strcmp(key, "is")) {
+            break;
+        case keyHash("is"):
             parseProperty(obj->mInnerRoundness);
-        } else if (0 == strcmp(key, "or")) {
+            break;
+        case keyHash("or"):
             parseProperty(obj->mOuterRadius);
-        } else if (0 == strcmp(key, "os")) {
+            break;
+        case keyHash("os"):
             parseProperty(obj->mOuterRoundness);
-        } else if (0 == strcmp(key, "r")) {
+            break;
+        case keyHash("r"):
             parseProperty(obj->mRotation);
-        } else if (0 == strcmp(key, "sy")) {
+            break;
+        case keyHash("sy"): {
             int starType = GetInt();
             if (starType == 1) obj->mPolyType = model::Polystar::PolyType::Star;
             if (starType == 2)
                 obj->mPolyType = model::Polystar::PolyType::Polygon;
-        } else if (0 == strcmp(key, "d")) {
+            break;
+        }
+        case keyHash("d"):
             obj->mDirection = GetInt();
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vDebug << "Polystar property ignored :" << key;
 #endif
             Skip(key);
+            break;
         }
     }
     obj->setStatic(
@@ -1399,23 +1680,31 @@ model::Trim *LottieParserImpl::parseTrimObject()
     auto obj = allocator().make<model::Trim>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "s")) {
+            break;
+        case keyHash("s"):
             parseProperty(obj->mStart);
-        } else if (0 == strcmp(key, "e")) {
+            break;
+        case keyHash("e"):
             parseProperty(obj->mEnd);
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        case keyHash("o"):
             parseProperty(obj->mOffset);
-        } else if (0 == strcmp(key, "m")) {
+            break;
+        case keyHash("m"):
             obj->mTrimType = getTrimType();
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vDebug << "Trim property ignored :" << key;
 #endif
             Skip(key);
+            break;
         }
     }
     obj->setStatic(obj->mStart.isStatic() && obj->mEnd.isStatic() &&
@@ -1428,20 +1717,28 @@ void LottieParserImpl::getValue(model::Repeater::Transform &obj)
     EnterObject();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "a")) {
+        switch (keyHash(key)) {
+        case keyHash("a"):
             parseProperty(obj.mAnchor);
-        } else if (0 == strcmp(key, "p")) {
+            break;
+        case keyHash("p"):
             parseProperty(obj.mPosition);
-        } else if (0 == strcmp(key, "r")) {
+            break;
+        case keyHash("r"):
             parseProperty(obj.mRotation);
-        } else if (0 == strcmp(key, "s")) {
+            break;
+        case keyHash("s"):
             parseProperty(obj.mScale);
-        } else if (0 == strcmp(key, "so")) {
+            break;
+        case keyHash("so"):
             parseProperty(obj.mStartOpacity);
-        } else if (0 == strcmp(key, "eo")) {
+            break;
+        case keyHash("eo"):
             parseProperty(obj.mEndOpacity);
-        } else {
+            break;
+        default:
             Skip(key);
+            break;
         }
     }
 }
@@ -1453,9 +1750,11 @@ model::Repeater *LottieParserImpl::parseReapeaterObject()
     obj->setContent(allocator().make<model::Group>());
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "c")) {
+            break;
+        case keyHash("c"): {
             parseProperty(obj->mCopies);
             float maxCopy = 0.0;
             if (!obj->mCopies.isStatic()) {
@@ -1469,17 +1768,23 @@ model::Repeater *LottieParserImpl::parseReapeaterObject()
                 maxCopy = obj->mCopies.value();
             }
             obj->mMaxCopies = maxCopy;
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        }
+        case keyHash("o"):
             parseProperty(obj->mOffset);
-        } else if (0 == strcmp(key, "tr")) {
+            break;
+        case keyHash("tr"):
             getValue(obj->mTransform);
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vDebug << "Repeater property ignored :" << key;
 #endif
             Skip(key);
+            break;
         }
     }
     obj->setStatic(obj->mCopies.isStatic() && obj->mOffset.isStatic() &&
@@ -1505,44 +1810,69 @@ model::Transform *LottieParserImpl::parseTransformObject(bool ddd)
     }
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             sharedTransform->setName(GetString());
-        } else if (0 == strcmp(key, "a")) {
+            break;
+        case keyHash("a"):
             parseProperty(obj->mAnchor);
-        } else if (0 == strcmp(key, "p")) {
+            break;
+        case keyHash("p"): {
             EnterObject();
             bool separate = false;
             while (const char *key = NextObjectKey()) {
-                if (0 == strcmp(key, "k")) {
+                switch (keyHash(key)) {
+                case keyHash("k"):
                     parsePropertyHelper(obj->mPosition);
-                } else if (0 == strcmp(key, "s")) {
+                    break;
+                case keyHash("s"):
                     obj->createExtraData();
                     obj->mExtra->mSeparate = GetBool();
                     separate = true;
-                } else if (separate && (0 == strcmp(key, "x"))) {
-                    parseProperty(obj->mExtra->mSeparateX);
-                } else if (separate && (0 == strcmp(key, "y"))) {
-                    parseProperty(obj->mExtra->mSeparateY);
-                } else {
+                    break;
+                case keyHash("x"):
+                    if (separate)
+                        parseProperty(obj->mExtra->mSeparateX);
+                    else
+                        Skip(key);
+                    break;
+                case keyHash("y"):
+                    if (separate)
+                        parseProperty(obj->mExtra->mSeparateY);
+                    else
+                        Skip(key);
+                    break;
+                default:
                     Skip(key);
+                    break;
                 }
             }
-        } else if (0 == strcmp(key, "r")) {
+            break;
+        }
+        case keyHash("r"):
             parseProperty(obj->mRotation);
-        } else if (0 == strcmp(key, "s")) {
+            break;
+        case keyHash("s"):
             parseProperty(obj->mScale);
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        case keyHash("o"):
             parseProperty(obj->mOpacity);
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             sharedTransform->setHidden(GetBool());
-        } else if (0 == strcmp(key, "rx")) {
+            break;
+        case keyHash("rx"):
             parseProperty(obj->mExtra->m3DRx);
-        } else if (0 == strcmp(key, "ry")) {
+            break;
+        case keyHash("ry"):
             parseProperty(obj->mExtra->m3DRy);
-        } else if (0 == strcmp(key, "rz")) {
+            break;
+        case keyHash("rz"):
             parseProperty(obj->mExtra->m3DRz);
-        } else {
+            break;
+        default:
             Skip(key);
+            break;
         }
     }
     bool isStatic = obj->mAnchor.isStatic() && obj->mPosition.isStatic() &&
@@ -1569,23 +1899,31 @@ model::Fill *LottieParserImpl::parseFillObject()
     auto obj = allocator().make<model::Fill>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "c")) {
+            break;
+        case keyHash("c"):
             parseProperty(obj->mColor);
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        case keyHash("o"):
             parseProperty(obj->mOpacity);
-        } else if (0 == strcmp(key, "fillEnabled")) {
+            break;
+        case keyHash("fillEnabled"):
             obj->mEnabled = GetBool();
-        } else if (0 == strcmp(key, "r")) {
+            break;
+        case keyHash("r"):
             obj->mFillRule = getFillRule();
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vWarning << "Fill property skipped = " << key;
 #endif
             Skip(key);
+            break;
         }
     }
     obj->setStatic(obj->mColor.isStatic() && obj->mOpacity.isStatic());
@@ -1655,32 +1993,44 @@ model::Stroke *LottieParserImpl::parseStrokeObject()
     auto obj = allocator().make<model::Stroke>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "c")) {
+            break;
+        case keyHash("c"):
             parseProperty(obj->mColor);
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        case keyHash("o"):
             parseProperty(obj->mOpacity);
-        } else if (0 == strcmp(key, "w")) {
+            break;
+        case keyHash("w"):
             parseProperty(obj->mWidth);
-        } else if (0 == strcmp(key, "fillEnabled")) {
+            break;
+        case keyHash("fillEnabled"):
             obj->mEnabled = GetBool();
-        } else if (0 == strcmp(key, "lc")) {
+            break;
+        case keyHash("lc"):
             obj->mCapStyle = getLineCap();
-        } else if (0 == strcmp(key, "lj")) {
+            break;
+        case keyHash("lj"):
             obj->mJoinStyle = getLineJoin();
-        } else if (0 == strcmp(key, "ml")) {
+            break;
+        case keyHash("ml"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             obj->mMiterLimit = GetDouble();
-        } else if (0 == strcmp(key, "d")) {
+            break;
+        case keyHash("d"):
             parseDashProperty(obj->mDash);
-        } else if (0 == strcmp(key, "hd")) {
+            break;
+        case keyHash("hd"):
             obj->setHidden(GetBool());
-        } else {
+            break;
+        default:
 #ifdef DEBUG_PARSER
             vWarning << "Stroke property skipped = " << key;
 #endif
             Skip(key);
+            break;
         }
     }
     obj->setStatic(obj->mColor.isStatic() && obj->mOpacity.isStatic() &&
@@ -1691,37 +2041,51 @@ model::Stroke *LottieParserImpl::parseStrokeObject()
 void LottieParserImpl::parseGradientProperty(model::Gradient *obj,
                                              const char *     key)
 {
-    if (0 == strcmp(key, "t")) {
+    switch (keyHash(key)) {
+    case keyHash("t"):
         RAPIDJSON_ASSERT(PeekType() == kNumberType);
         obj->mGradientType = GetInt();
-    } else if (0 == strcmp(key, "o")) {
+        break;
+    case keyHash("o"):
         parseProperty(obj->mOpacity);
-    } else if (0 == strcmp(key, "s")) {
+        break;
+    case keyHash("s"):
         parseProperty(obj->mStartPoint);
-    } else if (0 == strcmp(key, "e")) {
+        break;
+    case keyHash("e"):
         parseProperty(obj->mEndPoint);
-    } else if (0 == strcmp(key, "h")) {
+        break;
+    case keyHash("h"):
         parseProperty(obj->mHighlightLength);
-    } else if (0 == strcmp(key, "a")) {
+        break;
+    case keyHash("a"):
         parseProperty(obj->mHighlightAngle);
-    } else if (0 == strcmp(key, "g")) {
+        break;
+    case keyHash("g"):
         EnterObject();
         while (const char *key = NextObjectKey()) {
-            if (0 == strcmp(key, "k")) {
+            switch (keyHash(key)) {
+            case keyHash("k"):
                 parseProperty(obj->mGradient);
-            } else if (0 == strcmp(key, "p")) {
+                break;
+            case keyHash("p"):
                 obj->mColorPoints = GetInt();
-            } else {
+                break;
+            default:
                 Skip(nullptr);
+                break;
             }
         }
-    } else if (0 == strcmp(key, "hd")) {
+        break;
+    case keyHash("hd"):
         obj->setHidden(GetBool());
-    } else {
+        break;
+    default:
 #ifdef DEBUG_PARSER
         vWarning << "Gradient property skipped = " << key;
 #endif
         Skip(key);
+        break;
     }
     obj->setStatic(
         obj->mOpacity.isStatic() && obj->mStartPoint.isStatic() &&
@@ -1737,12 +2101,16 @@ model::GradientFill *LottieParserImpl::parseGFillObject()
     auto obj = allocator().make<model::GradientFill>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "r")) {
+            break;
+        case keyHash("r"):
             obj->mFillRule = getFillRule();
-        } else {
+            break;
+        default:
             parseGradientProperty(obj, key);
+            break;
         }
     }
     return obj;
@@ -1774,21 +2142,29 @@ model::GradientStroke *LottieParserImpl::parseGStrokeObject()
     auto obj = allocator().make<model::GradientStroke>();
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "nm")) {
+        switch (keyHash(key)) {
+        case keyHash("nm"):
             obj->setName(GetString());
-        } else if (0 == strcmp(key, "w")) {
+            break;
+        case keyHash("w"):
             parseProperty(obj->mWidth);
-        } else if (0 == strcmp(key, "lc")) {
+            break;
+        case keyHash("lc"):
             obj->mCapStyle = getLineCap();
-        } else if (0 == strcmp(key, "lj")) {
+            break;
+        case keyHash("lj"):
             obj->mJoinStyle = getLineJoin();
-        } else if (0 == strcmp(key, "ml")) {
+            break;
+        case keyHash("ml"):
             RAPIDJSON_ASSERT(PeekType() == kNumberType);
             obj->mMiterLimit = GetDouble();
-        } else if (0 == strcmp(key, "d")) {
+            break;
+        case keyHash("d"):
             parseDashProperty(obj->mDash);
-        } else {
+            break;
+        default:
             parseGradientProperty(obj, key);
+            break;
         }
     }
 
@@ -1900,17 +2276,23 @@ void LottieParserImpl::parsePathInfo()
     RAPIDJSON_ASSERT(PeekType() == kObjectType);
     EnterObject();
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "i")) {
+        switch (keyHash(key)) {
+        case keyHash("i"):
             getValue(mPathInfo.mInPoint);
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        case keyHash("o"):
             getValue(mPathInfo.mOutPoint);
-        } else if (0 == strcmp(key, "v")) {
+            break;
+        case keyHash("v"):
             getValue(mPathInfo.mVertices);
-        } else if (0 == strcmp(key, "c")) {
+            break;
+        case keyHash("c"):
             mPathInfo.mClosed = GetBool();
-        } else {
+            break;
+        default:
             RAPIDJSON_ASSERT(0);
             Skip(nullptr);
+            break;
         }
     }
     // exit properly from the array
@@ -1952,13 +2334,16 @@ template <>
 bool LottieParserImpl::parseKeyFrameValue(const char *           key,
                                           model::Value<VPointF> &value)
 {
-    if (0 == strcmp(key, "ti")) {
+    switch (keyHash(key)) {
+    case keyHash("ti"):
         value.mPathKeyFrame = true;
         getValue(value.mInTangent);
-    } else if (0 == strcmp(key, "to")) {
+        break;
+    case keyHash("to"):
         value.mPathKeyFrame = true;
         getValue(value.mOutTangent);
-    } else {
+        break;
+    default:
         return false;
     }
     return true;
@@ -2007,22 +2392,26 @@ void LottieParserImpl::parseKeyFrame(model::DynamicProperty<T> &obj)
     VPointF            outTangent;
 
     while (const char *key = NextObjectKey()) {
-        if (0 == strcmp(key, "i")) {
+        switch (keyHash(key)) {
+        case keyHash("i"):
             parsed.interpolator = true;
             inTangent = parseInperpolatorPoint();
-        } else if (0 == strcmp(key, "o")) {
+            break;
+        case keyHash("o"):
             outTangent = parseInperpolatorPoint();
-        } else if (0 == strcmp(key, "t")) {
+            break;
+        case keyHash("t"):
             keyframe.mStartFrame = GetDouble();
-        } else if (0 == strcmp(key, "s")) {
+            break;
+        case keyHash("s"):
             parsed.value = true;
             getValue(keyframe.mValue.mStartValue);
-            continue;
-        } else if (0 == strcmp(key, "e")) {
+            break;
+        case keyHash("e"):
             parsed.noEndValue = false;
             getValue(keyframe.mValue.mEndValue);
-            continue;
-        } else if (0 == strcmp(key, "n")) {
+            break;
+        case keyHash("n"):
             if (PeekType() == kStringType) {
                 parsed.interpolatorKey = GetString();
             } else {
@@ -2038,17 +2427,17 @@ void LottieParserImpl::parseKeyFrame(model::DynamicProperty<T> &obj)
                     }
                 }
             }
-            continue;
-        } else if (parseKeyFrameValue(key, keyframe.mValue)) {
-            continue;
-        } else if (0 == strcmp(key, "h")) {
+            break;
+        case keyHash("h"):
             parsed.hold = GetInt();
-            continue;
-        } else {
+            break;
+        default:
+            if (parseKeyFrameValue(key, keyframe.mValue)) break;
 #ifdef DEBUG_PARSER
             vDebug << "key frame property skipped = " << key;
 #endif
             Skip(key);
+            break;
         }
     }
 
@@ -2147,6 +2536,7 @@ void LottieParserImpl::parsePropertyHelper(model::Property<T> &obj)
                 break;
             }
         }
+        if (!obj.isStatic()) compRef->mAnimated.add(&obj.animation());
     }
 }
 
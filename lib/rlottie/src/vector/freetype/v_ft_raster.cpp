@@ -567,7 +567,8 @@ static void gray_render_line(RAS_ARG_ TPos to_x, TPos to_y)
             } while (ey1 != ey2);
     } else /* any other line */
     {
-        TArea prod = dx * fy1 - dy * fx1;
+        /* not a TArea, the products overflow an int past 32k pixels */
+        TPos prod = dx * fy1 - dy * fx1;
         SW_FT_UDIVPREP(dx);
         SW_FT_UDIVPREP(dy);
 
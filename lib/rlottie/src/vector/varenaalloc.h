@@ -130,6 +130,9 @@ public:
     // Destroy all allocated objects, free any heap allocations.
     void reset();
 
+    // Bytes of the heap blocks allocated so far.
+    size_t heapBytes() const { return fHeapBytes; }
+
 private:
     static void AssertRelease(bool cond) { if (!cond) { ::abort(); } }
     static uint32_t ToU32(size_t v) {
@@ -215,6 +218,7 @@ private:
     // allocated is fFib0 * fFirstHeapAllocationSize. Using 2 ^ n * fFirstHeapAllocationSize
     // had too much slop for Android.
     uint32_t       fFib0 {1}, fFib1 {1};
+    size_t         fHeapBytes {0};
 };
 
 // Helper for defining allocators with inline/reserved storage.
@@ -38,6 +38,17 @@ VBezier VBezier::fromPoints(const VPointF &p1, const VPointF &p2,
 }
 
 float VBezier::length() const
+{
+    return length(0);
+}
+
+/*
+ * Far from the origin the float error of the chord alone can exceed the
+ * tolerance, so the splitting is bounded by MaxLengthDepth.
+ */
+static constexpr int MaxLengthDepth = 16;
+
+float VBezier::length(int depth) const
 {
     VBezier left, right; /* bez poly splits */
     float   len = 0.0;   /* arc length */
@@ -50,10 +61,10 @@ float VBezier::length() const
 
     chord = VLine::length(x1, y1, x4, y4);
 
-    if ((len - chord) > 0.01) {
-        split(&left, &right);    /* split in two */
-        length = left.length() + /* try left side */
-                 right.length(); /* try right side */
+    if ((len - chord) > 0.01 && depth < MaxLengthDepth) {
+        split(&left, &right);             /* split in two */
+        length = left.length(depth + 1) + /* try left side */
+                 right.length(depth + 1); /* try right side */
 
         return length;
     }
@@ -92,12 +103,16 @@ float VBezier::tAtLength(float l) const
         float lLen = left.length();
         if (fabs(lLen - l) < error) break;
 
+        // long or degenerate curves may never come within the error, stop
+        // once the search runs out of float precision.
+        float lastT = t, lastB = lastBigger;
         if (lLen < l) {
             t += (lastBigger - t) * 0.5f;
         } else {
             lastBigger = t;
             t -= t * 0.5f;
         }
+        if (t == lastT && lastBigger == lastB) break;
     }
     return t;
 }
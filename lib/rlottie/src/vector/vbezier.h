@@ -44,6 +44,7 @@ public:
 
 private:
     VPointF derivative(float t) const;
+    float   length(int depth) const;
     float   x1, y1, x2, y2, x3, y3, x4, y4;
 };
 
@@ -22,6 +22,15 @@
 #include <cassert>
 #include <atomic>
 
+#ifdef LOTTIE_LOGGING_SUPPORT
+// number of deep copies made by write(), the renderer logs it per frame.
+inline std::atomic<std::size_t> &vcowDetachCount()
+{
+    static std::atomic<std::size_t> count{0};
+    return count;
+}
+#endif
+
 template <typename T>
 class vcow_ptr {
     struct model {
@@ -47,10 +56,19 @@ public:
         ++mModel->mRef;
     }
 
+// GCC >= 11 can't see that the shared default model never drops to a zero
+// refcount and reports a bogus free-nonheap-object on the delete below.
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfree-nonheap-object"
+#endif
     ~vcow_ptr()
     {
         if (mModel && (--mModel->mRef == 0)) delete mModel;
     }
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11)
+#pragma GCC diagnostic pop
+#endif
 
     template <class... Args>
     explicit vcow_ptr(Args&&... args) : mModel(new model(std::forward<Args>(args)...))
@@ -101,7 +119,12 @@ public:
 
     auto write() -> element_type&
     {
-        if (!unique()) *this = vcow_ptr(read());
+        if (!unique()) {
+#ifdef LOTTIE_LOGGING_SUPPORT
+            ++vcowDetachCount();
+#endif
+            *this = vcow_ptr(read());
+        }
 
         return mModel->mValue;
     }
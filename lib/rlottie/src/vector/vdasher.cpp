@@ -18,6 +18,7 @@
 
 #include "vbezier.h"
 
+#include <climits>
 #include <cmath>
 
 #include "vdasher.h"
@@ -26,7 +27,23 @@
 V_BEGIN_NAMESPACE
 
 static constexpr float tolerance = 0.1f;
-VDasher::VDasher(const float *dashArray, size_t size)
+
+/*
+ * Far outside of any canvas the float precision is too coarse to measure
+ * the segments, each dash would take ever longer to split off. The
+ * rasterizer clamps such coordinates anyway, so the path is left undashed.
+ */
+static bool measurable(const VPath &path)
+{
+    constexpr float MaxCoord = 1 << 20;
+    for (const auto &pt : path.points()) {
+        if (!(std::abs(pt.x()) <= MaxCoord && std::abs(pt.y()) <= MaxCoord))
+            return false;
+    }
+    return true;
+}
+
+VDasher::VDasher(const float *dashArray, size_t size, size_t maxPoints)
 {
     mDashArray = reinterpret_cast<const VDasher::Dash *>(dashArray);
     mArraySize = size / 2;
@@ -34,13 +51,22 @@ VDasher::VDasher(const float *dashArray, size_t size)
     mIndex = 0;
     mCurrentLength = 0;
     mDiscard = false;
+    mMaxPoints = maxPoints ? maxPoints : SHRT_MAX;
+    // negative or infinite lengths would never advance along the path, the
+    // path is drawn undashed instead.
+    for (size_t i = 0; i < size; i++) {
+        if (!std::isfinite(dashArray[i]) ||
+            (dashArray[i] < 0.0f && i < 2 * mArraySize))
+            mInvalid = true;
+    }
     //if the dash array contains ZERO length
     // segments or ZERO lengths gaps we could
     // optimize those usecase.
     for (size_t i = 0; i < mArraySize; i++) {
-        if (!vCompare(mDashArray[i].length, 0.0f))
+        // the same test as updateActiveSegment() which skips them.
+        if (!vIsZero(mDashArray[i].length))
             mNoLength = false;
-        if (!vCompare(mDashArray[i].gap, 0.0f))
+        if (!vIsZero(mDashArray[i].gap))
             mNoGap = false;
     }
 }
@@ -94,6 +120,7 @@ void VDasher::addLine(const VPointF &p)
         mStartNewSegment = false;
     }
     mResult->lineTo(p);
+    if (mResult->points().size() > mMaxPoints) mFull = true;
 }
 
 void VDasher::updateActiveSegment()
@@ -121,7 +148,7 @@ void VDasher::lineTo(const VPointF &p)
         mCurrentLength -= length;
         addLine(p);
     } else {
-        while (length > mCurrentLength) {
+        while (length > mCurrentLength && !mFull) {
             length -= mCurrentLength;
             line.splitAtLength(mCurrentLength, left, right);
 
@@ -152,6 +179,7 @@ void VDasher::addCubic(const VPointF &cp1, const VPointF &cp2, const VPointF &e)
         mStartNewSegment = false;
     }
     mResult->cubicTo(cp1, cp2, e);
+    if (mResult->points().size() > mMaxPoints) mFull = true;
 }
 
 void VDasher::cubicTo(const VPointF &cp1, const VPointF &cp2, const VPointF &e)
@@ -164,7 +192,7 @@ void VDasher::cubicTo(const VPointF &cp1, const VPointF &cp2, const VPointF &e)
         mCurrentLength -= bezLen;
         addCubic(cp1, cp2, e);
     } else {
-        while (bezLen > mCurrentLength) {
+        while (bezLen > mCurrentLength && !mFull) {
             bezLen -= mCurrentLength;
             b.splitAtLength(mCurrentLength, &left, &right);
 
@@ -191,11 +219,13 @@ void VDasher::dashHelper(const VPath &path, VPath &result)
     mResult = &result;
     mResult->reserve(path.points().size(), path.elements().size());
     mIndex = 0;
+    mFull = false;
     const std::vector<VPath::Element> &elms = path.elements();
     const std::vector<VPointF> &       pts = path.points();
     const VPointF *                    ptPtr = pts.data();
 
     for (auto &i : elms) {
+        if (mFull) break;
         switch (i) {
         case VPath::Element::MoveTo: {
             moveTo(*ptPtr++);
@@ -222,6 +252,8 @@ void VDasher::dashHelper(const VPath &path, VPath &result)
 
 void VDasher::dashed(const VPath &path, VPath &result)
 {
+    if (mInvalid || !measurable(path)) return result.clone(path);
+
     if (mNoLength && mNoGap) return result.reset();
 
     if (path.empty() || mNoLength) return result.reset();
@@ -235,6 +267,8 @@ void VDasher::dashed(const VPath &path, VPath &result)
 
 VPath VDasher::dashed(const VPath &path)
 {
+    if (mInvalid || !measurable(path)) return path;
+
     if (mNoLength && mNoGap) return path;
 
     if (path.empty() || mNoLength) return VPath();
@@ -24,7 +24,11 @@ V_BEGIN_NAMESPACE
 
 class VDasher {
 public:
-    VDasher(const float *dashArray, size_t size);
+    /*
+     * Dashing stops once the result has more than 'maxPoints' points, by
+     * default once it has more than the rasterizer can draw.
+     */
+    VDasher(const float *dashArray, size_t size, size_t maxPoints = 0);
     VPath dashed(const VPath &path);
     void dashed(const VPath &path, VPath &result);
 
@@ -50,6 +54,9 @@ private:
     float                mCurrentLength;
     float                mDashOffset{0};
     VPath               *mResult{nullptr};
+    size_t               mMaxPoints{0};
+    bool                 mFull{false};
+    bool                 mInvalid{false};
     bool                 mDiscard{false};
     bool                 mStartNewSegment{true};
     bool                 mNoLength{true};
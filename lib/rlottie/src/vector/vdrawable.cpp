@@ -46,30 +46,37 @@ void VDrawable::setType(VDrawable::Type type)
     }
 }
 
-void VDrawable::applyDashOp()
+void VDrawable::applyDashOp(size_t maxPoints)
 {
     if (mStrokeInfo && (mType == Type::StrokeWithDash)) {
         auto obj = static_cast<StrokeWithDashInfo *>(mStrokeInfo);
         if (!obj->mDash.empty()) {
-            VDasher dasher(obj->mDash.data(), obj->mDash.size());
-            mPath.clone(dasher.dashed(mPath));
+            VDasher dasher(obj->mDash.data(), obj->mDash.size(), maxPoints);
+            dasher.dashed(mPath, obj->mResult);
+            mPath = obj->mResult;
         }
     }
 }
 
-void VDrawable::preprocess(const VRect &clip)
+bool VDrawable::preprocess(const VRect &clip, size_t maxPoints)
 {
     if (mFlag & (DirtyState::Path)) {
+        if (mType != Type::Fill) applyDashOp(maxPoints);
+        if (maxPoints && mPath.points().size() > maxPoints) {
+            mPath = {};
+            mFlag &= ~DirtyFlag(DirtyState::Path);
+            return false;
+        }
         if (mType == Type::Fill) {
             mRasterizer.rasterize(std::move(mPath), mFillRule, clip);
         } else {
-            applyDashOp();
             mRasterizer.rasterize(std::move(mPath), mStrokeInfo->cap, mStrokeInfo->join,
                                   mStrokeInfo->width, mStrokeInfo->miterLimit, clip);
         }
         mPath = {};
         mFlag &= ~DirtyFlag(DirtyState::Path);
     }
+    return true;
 }
 
 VRle VDrawable::rle()
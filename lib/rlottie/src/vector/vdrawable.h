@@ -52,8 +52,10 @@ public:
     void setStrokeInfo(CapStyle cap, JoinStyle join, float miterLimit,
                        float strokeWidth);
     void setDashInfo(std::vector<float> &dashInfo);
-    void preprocess(const VRect &clip);
-    void applyDashOp();
+    // returns false, and rasterizes nothing, if the path has more than
+    // 'maxPoints' points after dashing.
+    bool preprocess(const VRect &clip, size_t maxPoints = 0);
+    void applyDashOp(size_t maxPoints = 0);
     VRle rle();
     void setName(const char *name)
     {
@@ -71,6 +73,7 @@ public:
 
     struct StrokeWithDashInfo : public StrokeInfo{
         std::vector<float> mDash;
+        VPath              mResult;
     };
 
 public:
@@ -56,6 +56,7 @@
 #include <cstring>
 #include <mutex>
 #include <unordered_map>
+#include "vtrace.h"
 
 class VGradientCache {
 public:
@@ -546,6 +547,7 @@ static void blendColorARGB(size_t count, const VRle::Span *spans,
 {
     VSpanData *data = (VSpanData *)(userData);
     Operator   op = getOperator(data, spans, count);
+    vTraceCount(SpansBlended, count);
     const uint color = data->mSolid;
 
     if (op.mode == BlendMode::Src) {
@@ -578,6 +580,7 @@ static void blendGradientARGB(size_t count, const VRle::Span *spans,
 {
     VSpanData *data = (VSpanData *)(userData);
     Operator   op = getOperator(data, spans, count);
+    vTraceCount(SpansBlended, count);
 
     unsigned int buffer[BLEND_GRADIENT_BUFFER_SIZE];
 
@@ -614,6 +617,7 @@ static void      blend_transformed_argb(size_t count, const VRle::Span *spans,
         //@TODO other formats not yet handled.
         return;
     }
+    vTraceCount(SpansBlended, count);
 
     Operator op = getOperator(data, spans, count);
     uint     buffer[buffer_size];
@@ -718,6 +722,7 @@ static void blend_untransformed_argb(size_t count, const VRle::Span *spans,
         //@TODO other formats not yet handled.
         return;
     }
+    vTraceCount(SpansBlended, count);
 
     Operator op = getOperator(data, spans, count);
 
@@ -157,15 +157,24 @@ struct VSpanData {
 
     VRect clipRect() const
     {
-        return VRect(0, 0, mDrawableSize.width(), mDrawableSize.height());
+        return VRect(mClipOrigin, mDrawableSize);
     }
 
     void setDrawRegion(const VRect &region)
     {
         mOffset = VPoint(region.left(), region.top());
+        mClipOrigin = VPoint();
         mDrawableSize = VSize(region.width(), region.height());
     }
 
+    // the buffer only holds the given area of the drawing.
+    void setBufferArea(const VRect &area)
+    {
+        mOffset = VPoint(-area.left(), -area.top());
+        mClipOrigin = VPoint(area.left(), area.top());
+        mDrawableSize = VSize(area.width(), area.height());
+    }
+
     uint *buffer(int x, int y) const
     {
         return (uint *)(mRasterBuffer->scanLine(y + mOffset.y())) + x + mOffset.x();
@@ -179,6 +188,7 @@ struct VSpanData {
     VSpanData::Type                      mType;
     std::shared_ptr<const VColorTable>   mColorTable{nullptr};
     VPoint                               mOffset; // offset to the subsurface
+    VPoint                               mClipOrigin;// clip rect position
     VSize                                mDrawableSize;// suburface size
     union {
         uint32_t      mSolid;
@@ -18,6 +18,8 @@
 
 #include "vpainter.h"
 #include <algorithm>
+#include <cstring>
+#include "vtrace.h"
 
 
 V_BEGIN_NAMESPACE
@@ -30,26 +32,71 @@ void VPainter::drawRle(const VPoint &, const VRle &rle)
 
     if (!mSpanData.mUnclippedBlendFunc) return;
 
+    vTraceSpan("VPainter::drawRle");
     // do draw after applying clip.
     rle.intersect(mSpanData.clipRect(), mSpanData.mUnclippedBlendFunc,
                   &mSpanData);
 }
 
+struct VClippedSpanData {
+    VRect      mClip;
+    VSpanData *mData;
+};
+
+static void clippedSpanCb(size_t count, const VRle::Span *spans,
+                          void *userData)
+{
+    auto *obj = static_cast<VClippedSpanData *>(userData);
+    const VRect &clip = obj->mClip;
+
+    const int  nspans = 256;
+    VRle::Span out[nspans];
+    int        n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const auto &span = spans[i];
+        if (span.y < clip.top() || span.y >= clip.bottom()) continue;
+        int x1 = std::max(int(span.x), clip.left());
+        int x2 = std::min(span.x + span.len, clip.right());
+        if (x2 <= x1) continue;
+
+        out[n].x = short(x1);
+        out[n].y = span.y;
+        out[n].len = ushort(x2 - x1);
+        out[n].coverage = span.coverage;
+        if (++n == nspans) {
+            obj->mData->mUnclippedBlendFunc(n, out, obj->mData);
+            n = 0;
+        }
+    }
+    if (n) obj->mData->mUnclippedBlendFunc(n, out, obj->mData);
+}
+
 void VPainter::drawRle(const VRle &rle, const VRle &clip)
 {
     if (rle.empty() || clip.empty()) return;
 
     if (!mSpanData.mUnclippedBlendFunc) return;
 
+    vTraceSpan("VPainter::drawRle");
+    // the rle can cross the clip rect when the buffer only holds part of
+    // the drawing.
+    if (!mSpanData.clipRect().contains(rle.boundingRect())) {
+        VClippedSpanData data{mSpanData.clipRect(), &mSpanData};
+        rle.intersect(clip, clippedSpanCb, &data);
+        return;
+    }
+
     rle.intersect(clip, mSpanData.mUnclippedBlendFunc, &mSpanData);
 }
 
 static void fillRect(const VRect &r, VSpanData *data)
 {
-    auto x1 = std::max(r.x(), 0);
-    auto x2 = std::min(r.x() + r.width(), data->mDrawableSize.width());
-    auto y1 = std::max(r.y(), 0);
-    auto y2 = std::min(r.y() + r.height(), data->mDrawableSize.height());
+    VRect clip = data->clipRect();
+    auto  x1 = std::max(r.x(), clip.left());
+    auto  x2 = std::min(r.x() + r.width(), clip.right());
+    auto  y1 = std::max(r.y(), clip.top());
+    auto  y2 = std::min(r.y() + r.height(), clip.bottom());
 
     if (x2 <= x1 || y2 <= y1) return;
 
@@ -100,6 +147,17 @@ bool VPainter::begin(VBitmap *buffer)
     mBuffer.clear();
     return true;
 }
+
+bool VPainter::begin(VBitmap *buffer, const VRect &area)
+{
+    mBuffer.prepare(buffer);
+    mSpanData.init(&mBuffer);
+    mSpanData.setBufferArea(area);
+    // only clear the part of the buffer that is going to be used.
+    for (int y = 0; y < area.height(); y++)
+        memset(mBuffer.scanLine(y), 0, area.width() * mBuffer.bytesPerPixel());
+    return true;
+}
 void VPainter::end() {}
 
 void VPainter::setDrawRegion(const VRect &region)
@@ -32,6 +32,7 @@ public:
     VPainter() = default;
     explicit VPainter(VBitmap *buffer);
     bool  begin(VBitmap *buffer);
+    bool  begin(VBitmap *buffer, const VRect &area); // buffer holds only area.
     void  end();
     void  setDrawRegion(const VRect &region); // sub surface rendering area.
     void  setBrush(const VBrush &brush);
@@ -29,13 +29,13 @@ V_BEGIN_NAMESPACE
  * if start > end it treates as a loop and trims as two segment
  *  [0-->end] and [start --> 1]
  */
-VPath VPathMesure::trim(const VPath &path)
+void VPathMesure::trim(const VPath &path, VPath &result)
 {
-    if (vCompare(mStart, mEnd)) return VPath();
+    if (vCompare(mStart, mEnd)) return result.reset();
 
     if ((vCompare(mStart, 0.0f) && (vCompare(mEnd, 1.0f))) ||
         (vCompare(mStart, 1.0f) && (vCompare(mEnd, 0.0f))))
-        return path;
+        return result.clone(path);
 
     float length = path.length();
 
@@ -46,8 +46,7 @@ VPath VPathMesure::trim(const VPath &path)
             std::numeric_limits<float>::max(),  // 2nd segment
         };
         VDasher dasher(array, 4);
-        dasher.dashed(path, mScratchObject);
-        return mScratchObject;
+        dasher.dashed(path, result);
     } else {
         float array[4] = {
             length * mEnd, (mStart - mEnd) * length,  // 1st segment
@@ -55,8 +54,7 @@ VPath VPathMesure::trim(const VPath &path)
             std::numeric_limits<float>::max(),  // 2nd segment
         };
         VDasher dasher(array, 4);
-        dasher.dashed(path, mScratchObject);
-        return mScratchObject;
+        dasher.dashed(path, result);
     }
 }
 
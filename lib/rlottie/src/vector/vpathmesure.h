@@ -28,11 +28,10 @@ public:
     void setRange(float start, float end) {mStart = start; mEnd = end;}
     void  setStart(float start){mStart = start;}
     void  setEnd(float end){mEnd = end;}
-    VPath trim(const VPath &path);
+    void  trim(const VPath &path, VPath &result);
 private:
     float mStart{0.0f};
     float mEnd{1.0f};
-    VPath mScratchObject;
 };
 
 V_END_NAMESPACE
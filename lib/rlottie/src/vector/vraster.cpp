@@ -17,7 +17,9 @@
  */
 
 #include "vraster.h"
+#include <algorithm>
 #include <climits>
+#include <cmath>
 #include <cstring>
 #include <memory>
 #include "config.h"
@@ -27,6 +29,7 @@
 #include "vmatrix.h"
 #include "vpath.h"
 #include "vrle.h"
+#include "vtrace.h"
 
 V_BEGIN_NAMESPACE
 
@@ -39,8 +42,9 @@ public:
     }
     void reserve(size_t size)
     {
-        if (mCapacity > size) return;
-        mCapacity = size;
+        if (mCapacity >= size) return;
+        // grow geometrically so that slowly growing outlines settle quickly
+        mCapacity = std::max(size, mCapacity * 2);
         mData = std::make_unique<T[]>(mCapacity);
     }
     T *        data() const { return mData.get(); }
@@ -63,9 +67,19 @@ public:
     void close();
     void end();
     void transform(const VMatrix &m);
+    // the rasterizer walks every cell between two points, coordinates much
+    // further out than any canvas only make it crawl and overflow the
+    // stroker. NaN is mapped to 0.
+    static float clampCoord(float x)
+    {
+        constexpr float MaxCoord = 1 << 20;
+        if (!(std::abs(x) <= MaxCoord))
+            x = x < 0 ? -MaxCoord : (x > 0 ? MaxCoord : 0);
+        return x;
+    }
     SW_FT_Pos TO_FT_COORD(float x)
     {
-        return SW_FT_Pos(x * 64);
+        return SW_FT_Pos(clampCoord(x) * 64);
     }  // to freetype 26.6 coordinate.
     SW_FT_Outline           ft;
     bool                    closed{false};
@@ -134,12 +148,12 @@ void FTOutline::convert(CapStyle cap, JoinStyle join, float width,
 {
     // map strokeWidth to freetype. It uses as the radius of the pen not the
     // diameter
-    width = width / 2.0f;
+    width = clampCoord(width) / 2.0f;
     // convert to freetype co-ordinate
     // IMP: stroker takes radius in 26.6 co-ordinate
     ftWidth = SW_FT_Fixed(width * (1 << 6));
     // IMP: stroker takes meterlimit in 16.16 co-ordinate
-    ftMiterLimit = SW_FT_Fixed(miterLimit * (1 << 16));
+    ftMiterLimit = SW_FT_Fixed(clampCoord(miterLimit) * (1 << 16));
 
     // map to freetype capstyle
     switch (cap) {
@@ -279,6 +293,7 @@ public:
     {
         if (!_pending) return;
 
+        vTraceSpan("VRasterizer::wait");
         {
             std::unique_lock<std::mutex> lock(_mutex);
             while (!_ready) _cv.wait(lock);
@@ -318,6 +333,9 @@ struct VRleTask {
     CapStyle  mCap;
     JoinStyle mJoin;
     bool      mGenerateStroke;
+#ifdef LOTTIE_TRACE_SUPPORT
+    uint64_t mQueuedAt{0};
+#endif
 
     VRle &rle() { return mRle.get(); }
 
@@ -368,10 +386,17 @@ struct VRleTask {
 
     void operator()(FTOutline &outRef, SW_FT_Stroker &stroker)
     {
-        if (mPath.points().size() > SHRT_MAX ||
-            mPath.points().size() + mPath.segments() > SHRT_MAX) {
+        if (!VRasterizer::canRasterize(mPath)) {
+            // the outline can't hold the path, draw nothing rather than
+            // leaving the rle of the previous frame pending.
+            mRle.unsafe().reset();
+            mPath = VPath();
+            mRle.notify();
             return;
         }
+#ifdef LOTTIE_TRACE_SUPPORT
+        uint64_t runStart = mQueuedAt ? VTrace::now() : 0;
+#endif
 
         if (mGenerateStroke) {  // Stroke Task
             outRef.convert(mPath);
@@ -406,6 +431,13 @@ struct VRleTask {
 
         mPath = VPath();
 
+#ifdef LOTTIE_TRACE_SUPPORT
+        // the queue wait is an argument, a span of its own would overlap
+        // the previous tasks of the render thread.
+        if (runStart)
+            VTrace::span("VRasterizer::rasterize", runStart, VTrace::now(),
+                         runStart - mQueuedAt);
+#endif
         mRle.notify();
     }
 };
@@ -530,10 +562,18 @@ void VRasterizer::init()
 
 void VRasterizer::updateRequest()
 {
+#ifdef LOTTIE_TRACE_SUPPORT
+    d->task().mQueuedAt = VTrace::enabled() ? VTrace::now() : 0;
+#endif
     VTask taskObj = VTask(d, &d->task());
     RleTaskScheduler::instance().process(std::move(taskObj));
 }
 
+bool VRasterizer::canRasterize(const VPath &path)
+{
+    return path.points().size() + path.segments() <= SHRT_MAX;
+}
+
 void VRasterizer::rasterize(VPath path, FillRule fillRule, const VRect &clip)
 {
     init();
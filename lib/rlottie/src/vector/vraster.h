@@ -34,6 +34,9 @@ public:
     void rasterize(VPath path, CapStyle cap, JoinStyle join, float width,
                    float miterLimit, const VRect &clip = VRect());
     VRle rle();
+    // false if the path has too many points for the outline, such a path
+    // is rasterized into an empty rle.
+    static bool canRasterize(const VPath &path);
 private:
     struct VRasterizerImpl;
     void init();
@@ -18,6 +18,7 @@
 
 #ifndef VRECT_H
 #define VRECT_H
+#include <algorithm>
 #include "vglobal.h"
 #include "vpoint.h"
 
@@ -57,6 +58,7 @@ public:
     friend VDebug &                operator<<(VDebug &os, const VRect &o);
 
     VRect intersected(const VRect &r) const;
+    VRect united(const VRect &r) const;
     VRect operator&(const VRect &r) const;
 
 private:
@@ -71,6 +73,19 @@ inline VRect VRect::intersected(const VRect &r) const
     return *this & r;
 }
 
+inline VRect VRect::united(const VRect &r) const
+{
+    if (empty()) return r;
+    if (r.empty()) return *this;
+
+    VRect tmp;
+    tmp.x1 = std::min(x1, r.x1);
+    tmp.y1 = std::min(y1, r.y1);
+    tmp.x2 = std::max(x2, r.x2);
+    tmp.y2 = std::max(y2, r.y2);
+    return tmp;
+}
+
 inline bool VRect::intersects(const VRect &r)
 {
     return (right() > r.left() && left() < r.right() && bottom() > r.top() &&
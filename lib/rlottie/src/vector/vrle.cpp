@@ -20,10 +20,13 @@
 #include <vrect.h>
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdlib>
+#include <limits>
 #include <vector>
 #include "vdebug.h"
 #include "vglobal.h"
+#include "vtrace.h"
 
 V_BEGIN_NAMESPACE
 
@@ -41,13 +44,41 @@ static void rleOpGeneric(VRleHelper *, VRleHelper *, VRleHelper *,
                          Operation op);
 static void rleSubstractWithRle(VRleHelper *, VRleHelper *, VRleHelper *);
 
+static std::atomic<size_t> sSpanBytes{0};
+static std::atomic<size_t> sPeakSpanBytes{0};
+
+size_t VRleMemory::bytes()
+{
+    return sSpanBytes.load(std::memory_order_relaxed);
+}
+
+size_t VRleMemory::peakBytes()
+{
+    return sPeakSpanBytes.load(std::memory_order_relaxed);
+}
+
+void VRleMemory::allocated(size_t bytes)
+{
+    size_t total =
+        sSpanBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = sPeakSpanBytes.load(std::memory_order_relaxed);
+    while (total > peak && !sPeakSpanBytes.compare_exchange_weak(
+                               peak, total, std::memory_order_relaxed))
+        ;
+}
+
+void VRleMemory::freed(size_t bytes)
+{
+    sSpanBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
 static inline uchar divBy255(int x)
 {
     return (x + (x >> 8) + 0x80) >> 8;
 }
 
 inline static void copyArrayToVector(const VRle::Span *span, size_t count,
-                                     std::vector<VRle::Span> &v)
+                                     VRle::SpanList &v)
 {
     // make sure enough memory available
     if (v.capacity() < v.size() + count) v.reserve(v.size() + count);
@@ -193,6 +224,7 @@ void VRle::VRleData::opIntersect(const VRect &r, VRle::VRleSpanCb cb,
 void VRle::VRleData::opSubstract(const VRle::VRleData &a,
                                  const VRle::VRleData &b)
 {
+    vTraceCount(RleOps, 1);
     // if two rle are disjoint
     if (!a.bbox().intersects(b.bbox())) {
         mSpans = a.mSpans;
@@ -246,6 +278,7 @@ void VRle::VRleData::opSubstract(const VRle::VRleData &a,
 void VRle::VRleData::opGeneric(const VRle::VRleData &a, const VRle::VRleData &b,
                                OpCode code)
 {
+    vTraceCount(RleOps, 1);
     // This routine assumes, obj1(span_y) < obj2(span_y).
 
     // reserve some space for the result vector.
@@ -320,7 +353,7 @@ void VRle::VRleData::opGeneric(const VRle::VRleData &a, const VRle::VRleData &b,
 
 static void rle_cb(size_t count, const VRle::Span *spans, void *userData)
 {
-    auto vector = static_cast<std::vector<VRle::Span> *>(userData);
+    auto vector = static_cast<VRle::SpanList *>(userData);
     copyArrayToVector(spans, count, *vector);
 }
 
@@ -356,6 +389,7 @@ void opIntersectHelper(const VRle::VRleData &obj1, const VRle::VRleData &obj2,
 void VRle::VRleData::opIntersect(const VRle::VRleData &obj1,
                                  const VRle::VRleData &obj2)
 {
+    vTraceCount(RleOps, 1);
     opIntersectHelper(obj1, obj2, rle_cb, &mSpans);
     updateBbox();
 }
@@ -19,6 +19,7 @@
 #ifndef VRLE_H
 #define VRLE_H
 
+#include <memory>
 #include <vector>
 #include "vcowptr.h"
 #include "vglobal.h"
@@ -27,6 +28,48 @@
 
 V_BEGIN_NAMESPACE
 
+/*
+ * Memory held by the spans of all the rles, the spans are allocated through
+ * VRleSpanAllocator which keeps the count.
+ */
+struct VRleMemory {
+    static size_t bytes();
+    static size_t peakBytes();
+    static void   allocated(size_t bytes);
+    static void   freed(size_t bytes);
+};
+
+template <typename T>
+struct VRleSpanAllocator {
+    using value_type = T;
+
+    VRleSpanAllocator() = default;
+    template <typename U>
+    VRleSpanAllocator(const VRleSpanAllocator<U> &)
+    {
+    }
+    T *allocate(size_t n)
+    {
+        VRleMemory::allocated(n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, size_t n)
+    {
+        VRleMemory::freed(n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+    template <typename U>
+    bool operator==(const VRleSpanAllocator<U> &) const
+    {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const VRleSpanAllocator<U> &) const
+    {
+        return false;
+    }
+};
+
 class VRle {
 public:
     struct Span {
@@ -37,6 +80,7 @@ public:
     };
     using VRleSpanCb =  void (*)(size_t count, const VRle::Span *spans,
                                  void *userData);
+    using SpanList = std::vector<Span, VRleSpanAllocator<Span>>;
     bool  empty() const;
     VRect boundingRect() const;
     void setBoundingRect(const VRect &bbox);
@@ -84,7 +128,7 @@ public:
         void  opIntersect(const VRle::VRleData &, const VRle::VRleData &);
         void  addRect(const VRect &rect);
         void  clone(const VRle::VRleData &);
-        std::vector<VRle::Span> mSpans;
+        VRle::SpanList          mSpans;
         VPoint                  mOffset;
         mutable VRect           mBbox;
         mutable bool            mBboxDirty = true;
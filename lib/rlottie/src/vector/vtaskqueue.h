@@ -19,23 +19,52 @@
 #ifndef VTASKQUEUE_H
 #define VTASKQUEUE_H
 
-#include <deque>
+#include <algorithm>
+#include <vector>
 
+/*
+ * The queue is a ring buffer which only grows, so once it has seen the
+ * peak number of pending tasks it no longer allocates (a deque allocates
+ * and frees its nodes as the tasks flow through it).
+ */
 template <typename Task>
 class TaskQueue {
     using lock_t = std::unique_lock<std::mutex>;
-    std::deque<Task>      _q;
+    std::vector<Task>       _q;
+    size_t                  _head{0};
+    size_t                  _count{0};
     bool                    _done{false};
     std::mutex              _mutex;
     std::condition_variable _ready;
 
+    bool empty() const { return _count == 0; }
+
+    void enqueue(Task &&task)
+    {
+        if (_count == _q.size()) {
+            std::vector<Task> q(std::max<size_t>(16, _q.size() * 2));
+            for (size_t i = 0; i < _count; i++)
+                q[i] = std::move(_q[(_head + i) % _q.size()]);
+            _q.swap(q);
+            _head = 0;
+        }
+        _q[(_head + _count) % _q.size()] = std::move(task);
+        _count++;
+    }
+
+    void dequeue(Task &task)
+    {
+        task = std::move(_q[_head]);
+        _head = (_head + 1) % _q.size();
+        _count--;
+    }
+
 public:
     bool try_pop(Task &task)
     {
         lock_t lock{_mutex, std::try_to_lock};
-        if (!lock || _q.empty()) return false;
-        task = std::move(_q.front());
-        _q.pop_front();
+        if (!lock || empty()) return false;
+        dequeue(task);
         return true;
     }
 
@@ -44,7 +73,7 @@ public:
         {
             lock_t lock{_mutex, std::try_to_lock};
             if (!lock) return false;
-            _q.push_back(std::move(task));
+            enqueue(std::move(task));
         }
         _ready.notify_one();
         return true;
@@ -62,10 +91,9 @@ public:
     bool pop(Task &task)
     {
         lock_t lock{_mutex};
-        while (_q.empty() && !_done) _ready.wait(lock);
-        if (_q.empty()) return false;
-        task = std::move(_q.front());
-        _q.pop_front();
+        while (empty() && !_done) _ready.wait(lock);
+        if (empty()) return false;
+        dequeue(task);
         return true;
     }
 
@@ -73,7 +101,7 @@ public:
     {
         {
             lock_t lock{_mutex};
-            _q.push_back(std::move(task));
+            enqueue(std::move(task));
         }
         _ready.notify_one();
     }
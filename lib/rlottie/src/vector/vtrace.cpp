@@ -0,0 +1,194 @@
+/*
+ * Render path tracing, added to rlottie by the tgswebp project in 2026.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "vtrace.h"
+
+#ifdef LOTTIE_TRACE_SUPPORT
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char *mName;
+    uint64_t    mStart;
+    uint64_t    mEnd;
+    uint64_t    mWaitNs;
+};
+
+struct CounterSample {
+    uint64_t mTime;
+    uint64_t mValues[VTrace::CounterCount];
+};
+
+/*
+ * The events are kept per thread so that the render threads don't contend
+ * on a lock while recording, a thread stops recording once it holds
+ * MaxThreadEvents.
+ */
+constexpr size_t MaxThreadEvents = 1 << 20;
+
+struct ThreadEvents {
+    std::mutex              mMutex;
+    std::vector<TraceEvent> mEvents;
+    size_t                  mId{0};
+};
+
+struct TraceState {
+    std::mutex                                 mMutex;
+    std::vector<std::unique_ptr<ThreadEvents>> mThreads;
+    std::vector<CounterSample>                 mSamples;
+    uint64_t                                   mOrigin{0};
+};
+
+// never destroyed, as the render threads may outlive the static objects.
+TraceState &traceState()
+{
+    static auto *state = new TraceState;
+    return *state;
+}
+
+ThreadEvents &threadEvents()
+{
+    static thread_local ThreadEvents *events = nullptr;
+    if (!events) {
+        auto &                      state = traceState();
+        std::lock_guard<std::mutex> lock(state.mMutex);
+        state.mThreads.push_back(std::make_unique<ThreadEvents>());
+        events = state.mThreads.back().get();
+        events->mId = state.mThreads.size();
+    }
+    return *events;
+}
+
+const char *counterName(size_t counter)
+{
+    switch (counter) {
+    case VTrace::SpansBlended:
+        return "spansBlended";
+    case VTrace::RleOps:
+        return "rleOps";
+    default:
+        return "surfacesAllocated";
+    }
+}
+
+}  // namespace
+
+std::atomic<bool>     VTrace::sEnabled{false};
+std::atomic<uint64_t> VTrace::sCounters[VTrace::CounterCount];
+
+uint64_t VTrace::now()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count());
+}
+
+bool VTrace::start()
+{
+    auto &                      state = traceState();
+    std::lock_guard<std::mutex> lock(state.mMutex);
+    for (auto &thread : state.mThreads) {
+        std::lock_guard<std::mutex> threadLock(thread->mMutex);
+        thread->mEvents.clear();
+    }
+    state.mSamples.clear();
+    for (auto &counter : sCounters) counter = 0;
+    state.mOrigin = now();
+    sEnabled = true;
+    return true;
+}
+
+void VTrace::span(const char *name, uint64_t start, uint64_t end,
+                  uint64_t waitNs)
+{
+    auto &                      events = threadEvents();
+    std::lock_guard<std::mutex> lock(events.mMutex);
+    if (events.mEvents.size() < MaxThreadEvents)
+        events.mEvents.push_back({name, start, end, waitNs});
+}
+
+void VTrace::sampleCounters()
+{
+    if (!enabled()) return;
+
+    CounterSample sample;
+    sample.mTime = now();
+    for (size_t i = 0; i < CounterCount; i++)
+        sample.mValues[i] = sCounters[i].exchange(0);
+
+    auto &                      state = traceState();
+    std::lock_guard<std::mutex> lock(state.mMutex);
+    state.mSamples.push_back(sample);
+}
+
+bool VTrace::write(const std::string &path)
+{
+    sEnabled = false;
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    auto &                      state = traceState();
+    std::lock_guard<std::mutex> lock(state.mMutex);
+    auto time = [&state](uint64_t t) {
+        return t > state.mOrigin ? double(t - state.mOrigin) / 1000 : 0.;
+    };
+
+    const char *separator = "\n";
+    fprintf(file, "{\"traceEvents\":[");
+    for (auto &thread : state.mThreads) {
+        std::lock_guard<std::mutex> threadLock(thread->mMutex);
+        for (const auto &e : thread->mEvents) {
+            fprintf(file,
+                    "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,"
+                    "\"ts\":%.3f,\"dur\":%.3f",
+                    separator, e.mName, thread->mId, time(e.mStart),
+                    double(e.mEnd - e.mStart) / 1000);
+            if (e.mWaitNs)
+                fprintf(file, ",\"args\":{\"wait_us\":%.3f}",
+                        double(e.mWaitNs) / 1000);
+            fprintf(file, "}");
+            separator = ",\n";
+        }
+        thread->mEvents.clear();
+    }
+    for (const auto &sample : state.mSamples) {
+        fprintf(file,
+                "%s{\"name\":\"rlottie\",\"ph\":\"C\",\"pid\":1,"
+                "\"ts\":%.3f,\"args\":{",
+                separator, time(sample.mTime));
+        for (size_t i = 0; i < CounterCount; i++) {
+            fprintf(file, "%s\"%s\":%llu", i ? "," : "", counterName(i),
+                    static_cast<unsigned long long>(sample.mValues[i]));
+        }
+        fprintf(file, "}}");
+        separator = ",\n";
+    }
+    state.mSamples.clear();
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    return fclose(file) == 0;
+}
+
+#endif  // LOTTIE_TRACE_SUPPORT
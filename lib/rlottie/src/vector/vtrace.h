@@ -0,0 +1,101 @@
+/*
+ * Render path tracing, added to rlottie by the tgswebp project in 2026.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef VTRACE_H
+#define VTRACE_H
+
+#include "config.h"
+
+/*
+ * Trace spans and counters of the render path, written out in the Chrome
+ * trace event format (chrome://tracing, ui.perfetto.dev). Only compiled in
+ * with LOTTIE_TRACE, and only recorded between VTrace::start() and
+ * VTrace::write().
+ *
+ *   vTraceSpan("VPainter::drawRle");       // times the enclosing scope
+ *   vTraceCount(RleOps, 1);                // adds to a per frame counter
+ *   vTraceSampleCounters();                // ends the frame's counters
+ */
+
+#ifdef LOTTIE_TRACE_SUPPORT
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class VTrace {
+public:
+    enum Counter { SpansBlended, RleOps, SurfacesAllocated, CounterCount };
+
+    static bool start();
+    static bool write(const std::string &path);
+    static bool enabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+    // nanoseconds on the steady clock.
+    static uint64_t now();
+    // records a complete event, a non zero 'waitNs' is shown as its
+    // "wait_us" argument.
+    static void span(const char *name, uint64_t start, uint64_t end,
+                     uint64_t waitNs = 0);
+    static void count(Counter counter, size_t n)
+    {
+        if (enabled())
+            sCounters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+    // records the counters since the previous sample and resets them.
+    static void sampleCounters();
+
+private:
+    static std::atomic<bool>     sEnabled;
+    static std::atomic<uint64_t> sCounters[CounterCount];
+};
+
+class VTraceSpan {
+public:
+    explicit VTraceSpan(const char *name)
+        : mName(name), mStart(VTrace::enabled() ? VTrace::now() : 0)
+    {
+    }
+    ~VTraceSpan()
+    {
+        if (mStart) VTrace::span(mName, mStart, VTrace::now());
+    }
+    VTraceSpan(const VTraceSpan &) = delete;
+    VTraceSpan &operator=(const VTraceSpan &) = delete;
+
+private:
+    const char *mName;
+    uint64_t    mStart;
+};
+
+#define VTRACE_CONCAT_(a, b) a##b
+#define VTRACE_CONCAT(a, b) VTRACE_CONCAT_(a, b)
+#define vTraceSpan(name) VTraceSpan VTRACE_CONCAT(traceSpan, __LINE__)(name)
+#define vTraceCount(counter, n) VTrace::count(VTrace::counter, n)
+#define vTraceSampleCounters() VTrace::sampleCounters()
+
+#else
+
+#define vTraceSpan(name)
+#define vTraceCount(counter, n)
+#define vTraceSampleCounters()
+
+#endif  // LOTTIE_TRACE_SUPPORT
+
+#endif  // VTRACE_H
@@ -0,0 +1,263 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "rlottie.h"
+#include "rlottiecommon.h"
+#include "vbitmap.h"
+#include "vbrush.h"
+#include "vpainter.h"
+#include "vpath.h"
+#include "vraster.h"
+#include "vrle.h"
+
+/*
+ * Microbenchmarks of the VRle set operations and of span blending. Each
+ * benchmark runs on two sets of rles: synthetic circles and rectangles, and
+ * the rles of the shapes and masks of a few bundled animations, which are
+ * rasterized from their render trees. The operations combine each rle with
+ * the next one in the set.
+ */
+
+static const int CanvasSize = 512;
+
+static VPath toPath(const float *points, size_t pointCount,
+                    const char *elements, size_t elementCount)
+{
+    VPath        path;
+    const float *pt = points;
+    const float *end = points + 2 * pointCount;
+    for (size_t i = 0; i < elementCount; i++) {
+        switch (VPath::Element(elements[i])) {
+        case VPath::Element::MoveTo:
+            if (pt + 2 > end) return path;
+            path.moveTo(pt[0], pt[1]);
+            pt += 2;
+            break;
+        case VPath::Element::LineTo:
+            if (pt + 2 > end) return path;
+            path.lineTo(pt[0], pt[1]);
+            pt += 2;
+            break;
+        case VPath::Element::CubicTo:
+            if (pt + 6 > end) return path;
+            path.cubicTo(pt[0], pt[1], pt[2], pt[3], pt[4], pt[5]);
+            pt += 6;
+            break;
+        case VPath::Element::Close:
+            path.close();
+            break;
+        }
+    }
+    return path;
+}
+
+static void addRle(VRasterizer &rasterizer, std::vector<VRle> &rles)
+{
+    VRle rle = rasterizer.rle();
+    if (!rle.empty()) rles.push_back(rle);
+}
+
+static void collectRles(const LOTLayerNode *layer, std::vector<VRle> &rles)
+{
+    const VRect clip(0, 0, CanvasSize, CanvasSize);
+    for (size_t i = 0; i < layer->mMaskList.size; i++) {
+        const auto &path = layer->mMaskList.ptr[i].mPath;
+        VRasterizer rasterizer;
+        rasterizer.rasterize(toPath(path.ptPtr, path.ptCount, path.elmPtr,
+                                    path.elmCount),
+                             FillRule::Winding, clip);
+        addRle(rasterizer, rles);
+    }
+    for (size_t i = 0; i < layer->mNodeList.size; i++) {
+        const LOTNode *node = layer->mNodeList.ptr[i];
+        VPath path = toPath(node->mPath.ptPtr, node->mPath.ptCount,
+                            node->mPath.elmPtr, node->mPath.elmCount);
+        VRasterizer rasterizer;
+        if (node->mStroke.enable) {
+            rasterizer.rasterize(std::move(path),
+                                 CapStyle(node->mStroke.cap),
+                                 JoinStyle(node->mStroke.join),
+                                 node->mStroke.width,
+                                 node->mStroke.miterLimit, clip);
+        } else {
+            rasterizer.rasterize(std::move(path),
+                                 node->mFillRule == FillEvenOdd
+                                     ? FillRule::EvenOdd
+                                     : FillRule::Winding,
+                                 clip);
+        }
+        addRle(rasterizer, rles);
+    }
+    for (size_t i = 0; i < layer->mLayerList.size; i++)
+        collectRles(layer->mLayerList.ptr[i], rles);
+}
+
+static const std::vector<VRle> &corpusRles()
+{
+    static std::vector<VRle> rles = [] {
+        std::vector<VRle> result;
+        const char *files[] = {"emoji_shock.json", "insta_camera.json",
+                               "mask.json", "tractor.json",
+                               "world_locations.json", "you're_in!.json"};
+        for (const char *file : files) {
+            auto animation = rlottie::Animation::loadFromFile(
+                std::string(DEMO_DIR) + file, false);
+            if (!animation) continue;
+            size_t frames = animation->totalFrame();
+            for (size_t frame : {frames / 4, frames / 2, 3 * frames / 4}) {
+                collectRles(
+                    animation->renderTree(frame, CanvasSize, CanvasSize),
+                    result);
+            }
+        }
+        return result;
+    }();
+    return rles;
+}
+
+static const std::vector<VRle> &syntheticRles()
+{
+    static std::vector<VRle> rles = [] {
+        std::vector<VRle> result;
+        const VRect clip(0, 0, CanvasSize, CanvasSize);
+        for (int i = 0; i < 64; i++) {
+            int x = (i * 37) % 400, y = (i * 53) % 400;
+            int size = 40 + (i * 13) % 120;
+            if (i % 2) {
+                result.push_back(VRle::toRle(VRect(x, y, size, size / 2)));
+                continue;
+            }
+            VPath path;
+            path.addCircle(x + size / 2, y + size / 2, size / 2);
+            VRasterizer rasterizer;
+            rasterizer.rasterize(std::move(path), FillRule::Winding, clip);
+            addRle(rasterizer, result);
+        }
+        return result;
+    }();
+    return rles;
+}
+
+static const std::vector<VRle> &rles(const benchmark::State &state)
+{
+    return state.range(0) ? corpusRles() : syntheticRles();
+}
+
+template <typename Op>
+static void runPairs(benchmark::State &state, Op op)
+{
+    const auto &set = rles(state);
+    for (auto _ : state) {
+        for (size_t i = 0; i + 1 < set.size(); i++) {
+            VRle result = op(set[i], set[i + 1]);
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) *
+                            int64_t(set.size() - 1));
+}
+
+static void BM_RleIntersect(benchmark::State &state)
+{
+    runPairs(state, [](const VRle &a, const VRle &b) { return a & b; });
+}
+
+static void BM_RleIntersectInPlace(benchmark::State &state)
+{
+    runPairs(state, [](const VRle &a, const VRle &b) {
+        VRle result = a;
+        result &= b;
+        return result;
+    });
+}
+
+static void BM_RleUnite(benchmark::State &state)
+{
+    runPairs(state, [](const VRle &a, const VRle &b) { return a + b; });
+}
+
+static void BM_RleSubtract(benchmark::State &state)
+{
+    runPairs(state, [](const VRle &a, const VRle &b) { return a - b; });
+}
+
+static void BM_RleXor(benchmark::State &state)
+{
+    runPairs(state, [](const VRle &a, const VRle &b) { return a ^ b; });
+}
+
+static void spanCountCb(size_t count, const VRle::Span *, void *userData)
+{
+    *static_cast<size_t *>(userData) += count;
+}
+
+static void BM_RleIntersectRect(benchmark::State &state)
+{
+    const auto &set = rles(state);
+    const VRect clip(CanvasSize / 4, CanvasSize / 4, CanvasSize / 2,
+                     CanvasSize / 2);
+    for (auto _ : state) {
+        size_t count = 0;
+        for (const auto &rle : set) rle.intersect(clip, spanCountCb, &count);
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) *
+                            int64_t(set.size()));
+}
+
+static void BM_RleToRle(benchmark::State &state)
+{
+    for (auto _ : state) {
+        for (int i = 0; i < 64; i++) {
+            VRle rle = VRle::toRle(
+                VRect(i, i * 3, CanvasSize - 2 * i, CanvasSize - 6 * i));
+            benchmark::DoNotOptimize(rle);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * 64);
+}
+
+static void runBlend(benchmark::State &state, const VBrush &brush)
+{
+    const auto &set = rles(state);
+    VBitmap     bitmap(CanvasSize, CanvasSize,
+                   VBitmap::Format::ARGB32_Premultiplied);
+    bitmap.fill(0);
+    VPainter painter(&bitmap);
+    painter.setBrush(brush);
+    for (auto _ : state) {
+        for (const auto &rle : set) painter.drawRle(VPoint(), rle);
+        benchmark::ClobberMemory();
+    }
+    painter.end();
+    state.SetItemsProcessed(int64_t(state.iterations()) *
+                            int64_t(set.size()));
+}
+
+static void BM_BlendColor(benchmark::State &state)
+{
+    runBlend(state, VBrush(40, 120, 200, 180));
+}
+
+static void BM_BlendGradient(benchmark::State &state)
+{
+    VGradient gradient(VGradient::Type::Linear);
+    gradient.linear = {0, 0, float(CanvasSize), float(CanvasSize)};
+    gradient.setStops({{0.0f, VColor(255, 80, 0, 255)},
+                       {1.0f, VColor(0, 80, 255, 160)}});
+    runBlend(state, VBrush(&gradient));
+}
+
+#define RLE_BENCHMARK(name) BENCHMARK(name)->ArgName("corpus")->Arg(0)->Arg(1)
+
+RLE_BENCHMARK(BM_RleIntersect);
+RLE_BENCHMARK(BM_RleIntersectInPlace);
+RLE_BENCHMARK(BM_RleUnite);
+RLE_BENCHMARK(BM_RleSubtract);
+RLE_BENCHMARK(BM_RleXor);
+RLE_BENCHMARK(BM_RleIntersectRect);
+BENCHMARK(BM_RleToRle);
+RLE_BENCHMARK(BM_BlendColor);
+RLE_BENCHMARK(BM_BlendGradient);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "rlottie.h"
+
+/*
+ * Fuzz target of the parser and of rendering one frame. With a compiler
+ * which provides libFuzzer it is built as a libFuzzer target, otherwise
+ * main() replays the files given on the command line, such as a corpus or
+ * an input which crashed. The render limits keep pathological inputs from
+ * timing the fuzzer out, exceeding one of them is an expected outcome.
+ */
+
+static const size_t CanvasSize = 64;
+
+static bool configure()
+{
+    rlottie::RenderLimits limits;
+    limits.maxRepeaterCopies = 1000;
+    limits.maxPathPoints = 10000;
+    limits.maxPrecompDepth = 16;
+    limits.maxFrameMs = 1000;
+    rlottie::configureRenderLimits(limits);
+    return true;
+}
+
+static rlottie::RenderError renderOneFrame(const uint8_t *data, size_t size)
+{
+    static bool configured = configure();
+    (void)configured;
+
+    // the inputs are not cached, a repeated key would return the model of
+    // an earlier input.
+    auto animation = rlottie::Animation::loadFromData(
+        std::string(reinterpret_cast<const char *>(data), size), "", "",
+        false);
+    if (!animation) return rlottie::RenderError::None;
+
+    uint32_t         buffer[CanvasSize * CanvasSize];
+    rlottie::Surface surface(buffer, CanvasSize, CanvasSize, CanvasSize * 4);
+    animation->renderSync(animation->totalFrame() / 2, surface);
+    return animation->renderError();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    renderOneFrame(data, size);
+    return 0;
+}
+
+#ifndef LOTTIE_FUZZ_LIBFUZZER
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: %s lottie_file...\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file) {
+            printf("%s: can't open\n", argv[i]);
+            return 1;
+        }
+        std::stringstream content;
+        content << file.rdbuf();
+        std::string data = content.str();
+        auto        error = renderOneFrame(
+            reinterpret_cast<const uint8_t *>(data.data()), data.size());
+        printf("%s: render error %d\n", argv[i], int(error));
+    }
+    return 0;
+}
+#endif
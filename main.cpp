@@ -10,7 +10,14 @@
 //
 // Authors: Diego Gl (diegulog@gmail.com)
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifdef HAVE_CONFIG_H
 #include "webp/config.h"
@@ -79,6 +86,690 @@ std::string gz_uncompress(gzFile in) {
     return json;
 }
 
+// Rendered ARGB frames, kept so that they can be encoded more than once.
+// Frames are kept as is in memory, or zlib-compressed in memory or in a
+// temporary spill file. Compressed frames can be delta-coded (XOR) against
+// the previous frame, which mostly leaves zeros for zlib.
+// Frames are read back in order through a Reader; each thread needs its own.
+class FrameStore {
+public:
+    enum Mode { kMemory, kCompressed, kSpillFile };
+
+    FrameStore(Mode mode, bool delta)
+        : mMode(mode), mDelta(delta && mode != kMemory) {}
+    ~FrameStore() { Reset(0, 0); }
+
+    // Drops all frames; frames added next are 'width' x 'height'.
+    void Reset(int width, int height) {
+        mFrames.clear();
+        mPacked.clear();
+        mSpans.clear();
+        mPrev.reset();
+        if (mFile != nullptr) fclose(mFile);
+        mFile = nullptr;
+        mFileSize = 0;
+        mStoredBytes = 0;
+        mWidth = width;
+        mHeight = height;
+    }
+
+    bool Add(const uint32_t *argb) {
+        const size_t num_pixels = size_t(mWidth) * mHeight;
+        if (mMode == kMemory) {
+            std::unique_ptr<uint32_t[]> frame(new uint32_t[num_pixels]);
+            memcpy(frame.get(), argb, num_pixels * sizeof(*argb));
+            mFrames.push_back(std::move(frame));
+            mStoredBytes += num_pixels * sizeof(*argb);
+            return true;
+        }
+        std::unique_ptr<uint32_t[]> delta;
+        const uint32_t *src = argb;
+        if (mDelta) {
+            if (mPrev == nullptr) {
+                mPrev.reset(new uint32_t[num_pixels]());
+            }
+            delta.reset(new uint32_t[num_pixels]);
+            for (size_t i = 0; i < num_pixels; ++i) {
+                delta[i] = argb[i] ^ mPrev[i];
+            }
+            memcpy(mPrev.get(), argb, num_pixels * sizeof(*argb));
+            src = delta.get();
+        }
+        uLongf packed_size = compressBound(num_pixels * sizeof(*argb));
+        std::vector<uint8_t> packed(packed_size);
+        if (compress2(packed.data(), &packed_size, (const Bytef *) src,
+                      num_pixels * sizeof(*argb), Z_BEST_SPEED) != Z_OK) {
+            return false;
+        }
+        packed.resize(packed_size);
+        mStoredBytes += packed_size;
+        if (mMode == kCompressed) {
+            mPacked.push_back(std::move(packed));
+            return true;
+        }
+        if (mFile == nullptr) mFile = tmpfile();
+        if (mFile == nullptr || fseek(mFile, 0, SEEK_END) != 0 ||
+            fwrite(packed.data(), 1, packed_size, mFile) != packed_size) {
+            return false;
+        }
+        mSpans.push_back({mFileSize, (size_t) packed_size});
+        mFileSize += packed_size;
+        return true;
+    }
+
+    size_t size() const {
+        return (mMode == kMemory) ? mFrames.size()
+               : (mMode == kCompressed) ? mPacked.size() : mSpans.size();
+    }
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+    // Bytes taken by the frames, in memory or on disk.
+    size_t StoredBytes() const { return mStoredBytes; }
+
+    class Reader {
+    public:
+        explicit Reader(const FrameStore &store) : mStore(store) {}
+
+        // Returns frame 'index', or nullptr on error. 'index' may not be
+        // lower than in the previous call. The frame stays valid until the
+        // next call.
+        const uint32_t *Read(size_t index) {
+            const size_t num_pixels =
+                size_t(mStore.mWidth) * mStore.mHeight;
+            if (mStore.mMode == kMemory) return mStore.mFrames[index].get();
+            if (mFrame == nullptr) {
+                mFrame.reset(new uint32_t[num_pixels]());
+                if (mStore.mDelta) mDelta.reset(new uint32_t[num_pixels]);
+            }
+            // Delta-coded frames need all the frames before them.
+            if (!mStore.mDelta) mNext = index;
+            for (; mNext <= index; ++mNext) {
+                uint32_t *const dst = mStore.mDelta ? mDelta.get()
+                                                    : mFrame.get();
+                if (!Unpack(mNext, dst, num_pixels)) return nullptr;
+                if (mStore.mDelta) {
+                    for (size_t i = 0; i < num_pixels; ++i) {
+                        mFrame[i] ^= mDelta[i];
+                    }
+                }
+            }
+            return mFrame.get();
+        }
+
+    private:
+        bool Unpack(size_t index, uint32_t *dst, size_t num_pixels) {
+            const uint8_t *packed;
+            size_t packed_size;
+            if (mStore.mMode == kCompressed) {
+                packed = mStore.mPacked[index].data();
+                packed_size = mStore.mPacked[index].size();
+            } else {
+                const Span &span = mStore.mSpans[index];
+                std::lock_guard<std::mutex> lock(mStore.mFileMutex);
+                mBuffer.resize(span.size);
+                if (fseek(mStore.mFile, long(span.offset), SEEK_SET) != 0 ||
+                    fread(mBuffer.data(), 1, span.size, mStore.mFile) !=
+                        span.size) {
+                    return false;
+                }
+                packed = mBuffer.data();
+                packed_size = span.size;
+            }
+            uLongf size = num_pixels * sizeof(*dst);
+            return uncompress((Bytef *) dst, &size, packed, packed_size) ==
+                       Z_OK && size == num_pixels * sizeof(*dst);
+        }
+
+        const FrameStore &mStore;
+        std::unique_ptr<uint32_t[]> mFrame;  // Last frame read.
+        std::unique_ptr<uint32_t[]> mDelta;
+        std::vector<uint8_t> mBuffer;        // Frame read from the file.
+        size_t mNext = 0;                    // Next frame to unpack.
+    };
+
+private:
+    struct Span {
+        size_t offset;
+        size_t size;
+    };
+
+    const Mode mMode;
+    const bool mDelta;
+    int mWidth = 0;
+    int mHeight = 0;
+    size_t mStoredBytes = 0;
+    std::vector<std::unique_ptr<uint32_t[]>> mFrames;  // kMemory
+    std::vector<std::vector<uint8_t>> mPacked;          // kCompressed
+    std::vector<Span> mSpans;                           // kSpillFile
+    FILE *mFile = nullptr;
+    size_t mFileSize = 0;
+    mutable std::mutex mFileMutex;
+    std::unique_ptr<uint32_t[]> mPrev;  // Last frame added, for delta coding.
+};
+
+static void PrintStoreStats(const FrameStore &store) {
+    const double raw_bytes =
+        4. * store.width() * store.height() * store.size();
+    fprintf(stderr, "Frame store: %u frames, %u bytes (%.1f%% of raw)\n",
+            (unsigned int) store.size(), (unsigned int) store.StoredBytes(),
+            raw_bytes > 0 ? 100. * store.StoredBytes() / raw_bytes : 0.);
+}
+
+// Prints the render limit 'player' exceeded, if any, while rendering
+// 'frame' or, if it is negative, when it was loaded. Returns false if it
+// exceeded one.
+static bool CheckRenderError(const rlottie::Animation &player, int frame) {
+    const char *limit = nullptr;
+    switch (player.renderError()) {
+        case rlottie::RenderError::None:
+            return true;
+        case rlottie::RenderError::RepeaterCopies:
+            limit = "-max_repeater_copies";
+            break;
+        case rlottie::RenderError::PathPoints:
+            limit = "-max_path_points";
+            break;
+        case rlottie::RenderError::PrecompDepth:
+            limit = "-max_precomp_depth";
+            break;
+        case rlottie::RenderError::FrameTime:
+            limit = "-max_frame_ms";
+            break;
+    }
+    if (frame < 0) {
+        fprintf(stderr, "Error! The animation exceeds %s.\n", limit);
+    } else {
+        fprintf(stderr, "Error! Frame %d exceeds %s.\n", frame, limit);
+    }
+    return false;
+}
+
+// Renders every 'skip'-th frame of 'player' at 'width' x 'height' into
+// 'store'.
+static bool RenderFrames(rlottie::Animation *player, int width, int height,
+                         int skip, FrameStore *store) {
+    const int total_frames = (int) player->totalFrame();
+    std::unique_ptr<uint32_t[]> buffer(new uint32_t[width * height]);
+    store->Reset(width, height);
+    for (int i = 0; i < total_frames; i += skip) {
+        rlottie::Surface surface(buffer.get(), width, height, width * 4);
+        player->renderSync(i, surface);
+        if (!CheckRenderError(*player, i)) return false;
+        if (!store->Add(buffer.get())) {
+            fprintf(stderr, "Error while storing frame %d\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Encodes every 'step'-th frame of 'store' into an animation, each frame
+// lasting 'frame_duration' ms. If 'frame_ms' is not null, the time taken to
+// add each frame is appended to it. Returns false on error.
+static bool EncodeFrames(const FrameStore &store, int step,
+                         int frame_duration,
+                         const WebPAnimEncoderOptions *enc_options,
+                         const WebPConfig *config, WebPData *webp_data,
+                         std::vector<double> *frame_ms = nullptr) {
+    const int width = store.width(), height = store.height();
+    WebPAnimEncoder *enc = WebPAnimEncoderNew(width, height, enc_options);
+    FrameStore::Reader reader(store);
+    int timestamp = 0;
+    bool ok = (enc != nullptr);
+    for (size_t i = 0; ok && i < store.size(); i += step) {
+        WebPPicture frame;
+        const uint32_t *const argb = reader.Read(i);
+        ok = (argb != nullptr) && WebPPictureInit(&frame);
+        if (!ok) break;
+        // The encoder only reads the frame, so it can point at the buffer.
+        frame.width = width;
+        frame.height = height;
+        frame.use_argb = 1;
+        frame.argb = const_cast<uint32_t *>(argb);
+        frame.argb_stride = width;
+        const auto start = std::chrono::steady_clock::now();
+        ok = WebPAnimEncoderAdd(enc, &frame, timestamp, config);
+        if (frame_ms != nullptr) {
+            frame_ms->push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+        timestamp += frame_duration;
+    }
+    ok = ok && WebPAnimEncoderAdd(enc, nullptr, timestamp, nullptr);
+    ok = ok && WebPAnimEncoderAssemble(enc, webp_data);
+    if (!ok && enc != nullptr) {
+        fprintf(stderr, "Error while encoding: %s\n",
+                WebPAnimEncoderGetError(enc));
+    }
+    WebPAnimEncoderDelete(enc);
+    return ok;
+}
+
+// Frame skip multiplier and frame size (in percent) tried in turn by
+// -target_steps when the lowest quality is still too big.
+static const struct {
+    int skip_factor;
+    int scale;
+} kTargetSteps[] = {{1, 100}, {2, 100}, {2, 75}, {2, 50}};
+
+// Encodes the animation under 'target_size' bytes and returns the number of
+// frames in it in 'num_encoded'. The quality is searched between 0 and
+// 'config->quality'; if even quality 0 is too big and 'use_steps' is set, the
+// frame skip is raised and then the frame size is lowered. Frames are rendered
+// into 'frames' once per frame size. Stops at the first step with a result
+// under budget, keeping its highest quality one in 'webp_data'.
+static bool EncodeToTargetSize(rlottie::Animation *player, FrameStore *frames,
+                               int width, int height, int skip,
+                               size_t target_size,
+                               bool use_steps, int verbose,
+                               const WebPAnimEncoderOptions *enc_options,
+                               const WebPConfig *config, WebPData *webp_data,
+                               int *num_encoded) {
+    const int total_frames = (int) player->totalFrame();
+    const int duration = int(player->duration() * 1000);
+    const int num_steps = use_steps ? int(sizeof(kTargetSteps) /
+                                          sizeof(kTargetSteps[0])) : 1;
+    size_t smallest_size = 0;
+    int frames_scale = 0, frames_skip = 0;
+    bool found = false;
+
+    for (int step = 0; !found && step < num_steps; ++step) {
+        const int step_skip = skip * kTargetSteps[step].skip_factor;
+        const int scale = kTargetSteps[step].scale;
+        const int step_width = width * scale / 100;
+        const int step_height = height * scale / 100;
+        const int num_frames = std::max(total_frames / step_skip, 1);
+        const int frame_duration = duration / num_frames;
+        WebPConfig step_config = *config;
+        float lo = 0.f, hi = config->quality;
+        float q = config->quality;
+        int frame_step;
+        if (scale != frames_scale || step_skip % frames_skip != 0) {
+            // Rendered frames are reused for larger skips of the same size.
+            if (!RenderFrames(player, step_width, step_height, step_skip,
+                              frames)) {
+                return false;
+            }
+            frames_scale = scale;
+            frames_skip = step_skip;
+            if (verbose) PrintStoreStats(*frames);
+        }
+        frame_step = step_skip / frames_skip;
+        for (;;) {
+            WebPData data;
+            WebPDataInit(&data);
+            step_config.quality = q;
+            if (!EncodeFrames(*frames, frame_step, frame_duration, enc_options,
+                              &step_config, &data)) {
+                WebPDataClear(&data);
+                return false;
+            }
+            if (verbose) {
+                fprintf(stderr, "Target size: -q %.1f -s %d %dx%d: %u bytes\n",
+                        q, step_skip, step_width, step_height,
+                        (unsigned int) data.size);
+            }
+            if (smallest_size == 0 || data.size < smallest_size) {
+                smallest_size = data.size;
+            }
+            if (data.size <= target_size) {
+                // Keep the highest quality under budget.
+                WebPDataClear(webp_data);
+                *webp_data = data;
+                *num_encoded =
+                    int((frames->size() + frame_step - 1) / frame_step);
+                found = true;
+                lo = q;
+            } else {
+                WebPDataClear(&data);
+                hi = q;
+            }
+            if (q == config->quality && found) break;  // Fits as is.
+            // Lossless sizes barely depend on the quality, which only sets
+            // the effort, so they are not searched.
+            if (config->lossless) break;
+            if (!found && q == 0.f) break;  // Too big even at quality 0.
+            // Tries quality 0 first, then bisects to within 2 of the best.
+            if (!found) {
+                q = 0.f;
+            } else if (hi - lo > 2.f) {
+                q = (lo + hi) / 2.f;
+            } else {
+                break;
+            }
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "Could not reach the target size of %u bytes; the "
+                "smallest result was %u bytes.\n", (unsigned int) target_size,
+                (unsigned int) smallest_size);
+    }
+    return found;
+}
+
+// Parses the encoder option at 'argv[*c]', moving '*c' past its argument.
+// Returns false if it is not an encoder option.
+static bool ParseEncoderOption(int argc, const char *argv[], int *c,
+                               WebPConfig *config,
+                               WebPAnimEncoderOptions *enc_options,
+                               int *kmin_set, int *kmax_set,
+                               int *parse_error) {
+    const char *const arg = argv[*c];
+    const bool has_value = (*c < argc - 1);
+    if (!strcmp(arg, "-lossy")) {
+        config->lossless = 0;
+    } else if (!strcmp(arg, "-mixed")) {
+        enc_options->allow_mixed = 1;
+        config->lossless = 0;
+    } else if (!strcmp(arg, "-q") && has_value) {
+        config->quality = ExUtilGetFloat(argv[++*c], parse_error);
+    } else if (!strcmp(arg, "-m") && has_value) {
+        config->method = ExUtilGetInt(argv[++*c], 0, parse_error);
+    } else if (!strcmp(arg, "-no_predict")) {
+        enc_options->mixed_predictor = 0;
+    } else if (!strcmp(arg, "-predict_bench")) {
+        enc_options->mixed_predictor = 2;
+    } else if (!strcmp(arg, "-no_reuse")) {
+        enc_options->reuse_frames = 0;
+    } else if (!strcmp(arg, "-min_size")) {
+        enc_options->minimize_size = 1;
+    } else if (!strcmp(arg, "-kmin") && has_value) {
+        enc_options->kmin = ExUtilGetInt(argv[++*c], 0, parse_error);
+        *kmin_set = 1;
+    } else if (!strcmp(arg, "-kmax") && has_value) {
+        enc_options->kmax = ExUtilGetInt(argv[++*c], 0, parse_error);
+        *kmax_set = 1;
+    } else if (!strcmp(arg, "-f") && has_value) {
+        config->filter_strength = ExUtilGetInt(argv[++*c], 0, parse_error);
+    } else if (!strcmp(arg, "-mt")) {
+        ++config->thread_level;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Applies the defaults that depend on the parsed encoder options. Returns
+// false if the resulting configuration is invalid.
+static bool FinishEncoderConfig(int kmin_set, int kmax_set, WebPConfig *config,
+                                WebPAnimEncoderOptions *enc_options) {
+    if (!enc_options->allow_mixed) config->lossless = 1;
+    // key frames are only inserted on request; same defaults as gif2webp
+    if (kmin_set && !kmax_set) enc_options->kmax = config->lossless ? 17 : 5;
+    if (kmax_set && !kmin_set) enc_options->kmin = config->lossless ? 9 : 3;
+    config->sns_strength = 90;
+    config->filter_sharpness = 6;
+    config->alpha_quality = 5;
+    return WebPValidateConfig(config);
+}
+
+// Encodes the frames of 'store' once per entry of 'sweeps', each a list of
+// encoder options applied on top of 'base_config' and 'base_enc_options'.
+// 'kmin_set' and 'kmax_set' tell whether the base options set -kmin and -kmax.
+// The encodes run concurrently; their sizes and times are printed.
+static bool RunSweeps(const FrameStore &store, int frame_duration,
+                      const std::vector<std::string> &sweeps,
+                      const WebPConfig *base_config,
+                      const WebPAnimEncoderOptions *base_enc_options,
+                      int base_kmin_set, int base_kmax_set) {
+    struct Sweep {
+        WebPConfig config;
+        WebPAnimEncoderOptions enc_options;
+        WebPData webp_data;
+        double time_ms;
+        bool ok;
+    };
+    std::vector<Sweep> runs(sweeps.size());
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < sweeps.size(); ++i) {
+        std::vector<std::string> words;
+        std::vector<const char *> args;
+        size_t start = 0;
+        int kmin_set = base_kmin_set, kmax_set = base_kmax_set;
+        Sweep &run = runs[i];
+        run.config = *base_config;
+        run.enc_options = *base_enc_options;
+        WebPDataInit(&run.webp_data);
+        while (start < sweeps[i].size()) {
+            const size_t end = std::min(sweeps[i].find(' ', start),
+                                        sweeps[i].size());
+            if (end > start) words.push_back(sweeps[i].substr(start,
+                                                              end - start));
+            start = end + 1;
+        }
+        for (const std::string &word : words) args.push_back(word.c_str());
+        for (int c = 0; c < int(args.size()); ++c) {
+            int parse_error = 0;
+            if (!ParseEncoderOption(int(args.size()), args.data(), &c,
+                                    &run.config, &run.enc_options, &kmin_set,
+                                    &kmax_set, &parse_error) || parse_error) {
+                fprintf(stderr, "Error! Invalid sweep option '%s' in '%s'\n",
+                        args[c], sweeps[i].c_str());
+                return false;
+            }
+        }
+        if (!FinishEncoderConfig(kmin_set, kmax_set, &run.config,
+                                 &run.enc_options)) {
+            fprintf(stderr, "Error! Invalid configuration in sweep '%s'\n",
+                    sweeps[i].c_str());
+            return false;
+        }
+    }
+
+    for (Sweep &run : runs) {
+        threads.emplace_back([&store, frame_duration, &run]() {
+            const auto start = std::chrono::steady_clock::now();
+            run.ok = EncodeFrames(store, 1, frame_duration, &run.enc_options,
+                                  &run.config, &run.webp_data);
+            run.time_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+        });
+    }
+    for (std::thread &thread : threads) thread.join();
+
+    bool ok = true;
+    fprintf(stderr, "%-32s %10s %10s\n", "Sweep", "Bytes", "Time (ms)");
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const char *const name =
+            sweeps[i].empty() ? "(no options)" : sweeps[i].c_str();
+        if (runs[i].ok) {
+            fprintf(stderr, "%-32s %10u %10.0f\n", name,
+                    (unsigned int) runs[i].webp_data.size, runs[i].time_ms);
+        } else {
+            fprintf(stderr, "%-32s %10s\n", name, "failed");
+            ok = false;
+        }
+        WebPDataClear(&runs[i].webp_data);
+    }
+    return ok;
+}
+
+// Prints the min, median and 99th percentile of the per-frame times
+// 'frame_ms' and the mean time of one of the 'passes' over the animation.
+static void PrintBenchTimes(const char *what, std::vector<double> frame_ms,
+                            int passes, double total_ms) {
+    if (frame_ms.empty()) return;
+    std::sort(frame_ms.begin(), frame_ms.end());
+    const size_t n = frame_ms.size();
+    const size_t p99 = std::min(n - 1, (n * 99 + 99) / 100 - 1);
+    fprintf(stderr, "%s: %d x %u frames, per frame min %.3f / median %.3f / "
+            "p99 %.3f ms, %.1f ms per animation\n", what, passes,
+            (unsigned int) (n / passes), frame_ms[0], frame_ms[n / 2],
+            frame_ms[p99], total_ms / passes);
+}
+
+// Renders every 'skip'-th frame of 'player' 'passes' times, without encoding,
+// and prints the render times.
+static bool BenchRender(rlottie::Animation *player, int width, int height,
+                        int skip, int passes) {
+    const int total_frames = (int) player->totalFrame();
+    std::unique_ptr<uint32_t[]> buffer(new uint32_t[width * height]);
+    std::vector<double> frame_ms;
+    double total_ms = 0.;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (int i = 0; i < total_frames; i += skip) {
+            rlottie::Surface surface(buffer.get(), width, height, width * 4);
+            const auto start = std::chrono::steady_clock::now();
+            player->renderSync(i, surface);
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count());
+            total_ms += frame_ms.back();
+            if (!CheckRenderError(*player, i)) return false;
+        }
+    }
+    PrintBenchTimes("Render", frame_ms, passes, total_ms);
+    return true;
+}
+
+// Encodes the frames of 'store' 'passes' times and prints the time taken to
+// add each frame to the encoder and to encode the whole animation.
+static bool BenchEncode(const FrameStore &store, int frame_duration,
+                        int passes, const WebPAnimEncoderOptions *enc_options,
+                        const WebPConfig *config) {
+    std::vector<double> frame_ms;
+    double total_ms = 0.;
+    size_t bytes = 0;
+    for (int pass = 0; pass < passes; ++pass) {
+        WebPData webp_data;
+        WebPDataInit(&webp_data);
+        const auto start = std::chrono::steady_clock::now();
+        const bool ok = EncodeFrames(store, 1, frame_duration, enc_options,
+                                     config, &webp_data, &frame_ms);
+        total_ms += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        bytes = webp_data.size;
+        WebPDataClear(&webp_data);
+        if (!ok) return false;
+    }
+    PrintBenchTimes("Encode", frame_ms, passes, total_ms);
+    fprintf(stderr, "Encode: %u bytes\n", (unsigned int) bytes);
+    return true;
+}
+
+// Returns the highest memory held so far by 'player' and 'enc' together,
+// summing the peaks of the parts, so it may overestimate.
+static size_t PeakMemory(const rlottie::Animation &player,
+                         const WebPAnimEncoder *enc) {
+    const rlottie::MemoryUsage usage = player.memoryUsage();
+    WebPAnimEncoderMemory memory;
+    size_t peak = usage.modelBytes + usage.rendererBytes +
+                  usage.peakSurfaceBytes + usage.peakRleBytes;
+    if (WebPAnimEncoderGetMemory(enc, &memory)) peak += memory.peak;
+    return peak;
+}
+
+static void PrintMemory(const rlottie::Animation &player,
+                        const WebPAnimEncoder *enc) {
+    const rlottie::MemoryUsage usage = player.memoryUsage();
+    WebPAnimEncoderMemory memory;
+    if (!WebPAnimEncoderGetMemory(enc, &memory)) {
+        memset(&memory, 0, sizeof(memory));
+    }
+    fprintf(stderr, "Memory (KB): model %u, renderer %u, surfaces %u "
+            "(peak %u), rle %u (peak %u)\n",
+            (unsigned int) (usage.modelBytes >> 10),
+            (unsigned int) (usage.rendererBytes >> 10),
+            (unsigned int) (usage.surfaceBytes >> 10),
+            (unsigned int) (usage.peakSurfaceBytes >> 10),
+            (unsigned int) (usage.rleBytes >> 10),
+            (unsigned int) (usage.peakRleBytes >> 10));
+    fprintf(stderr, "             encoder canvases %u, frames %u, "
+            "candidates %u, mux %u (peak %u); total peak %u\n",
+            (unsigned int) (memory.canvases >> 10),
+            (unsigned int) (memory.frames >> 10),
+            (unsigned int) (memory.candidates >> 10),
+            (unsigned int) (memory.mux >> 10),
+            (unsigned int) (memory.peak >> 10),
+            (unsigned int) (PeakMemory(player, enc) >> 10));
+}
+
+// Prints what rlottie::Animation::complexity() reports on 'player', one
+// "name: value" per line.
+static void PrintComplexity(const rlottie::Animation &player) {
+    const rlottie::Complexity c = player.complexity();
+    printf("frames: %u\n", (unsigned int) player.totalFrame());
+    printf("layers: %u\n", (unsigned int) c.layers);
+    printf("shapes: %u\n", (unsigned int) c.shapes);
+    printf("fills: %u\n", (unsigned int) c.fills);
+    printf("strokes: %u\n", (unsigned int) c.strokes);
+    printf("gradients: %u\n", (unsigned int) c.gradients);
+    printf("trim_paths: %u\n", (unsigned int) c.trimPaths);
+    printf("repeaters: %u\n", (unsigned int) c.repeaters);
+    printf("masks: %u\n", (unsigned int) c.masks);
+    printf("mattes: %u\n", (unsigned int) c.mattes);
+    printf("keyframes: %u\n", (unsigned int) c.keyFrames);
+    printf("image_assets: %u\n", (unsigned int) c.imageAssets);
+    printf("matte_depth: %u\n", (unsigned int) c.maxMatteDepth);
+    printf("mask_depth: %u\n", (unsigned int) c.maxMaskDepth);
+    printf("precomp_depth: %u\n", (unsigned int) c.maxPrecompDepth);
+    printf("repeater_copies: %u\n", (unsigned int) c.maxRepeaterCopies);
+    printf("cost: %.0f\n", c.cost);
+}
+
+static const char *const kCandidateNames[WEBP_ANIM_CANDIDATE_COUNT] = {
+    "ll_none", "ll_bg", "lossy_none", "lossy_bg"
+};
+
+// Writes the per-frame statistics of 'enc' as CSV to 'path' and prints a
+// summary.
+static bool WriteFrameStats(WebPAnimEncoder *enc, const char *path) {
+    int num_frames = 0;
+    const WebPAnimFrameStats *const stats =
+        WebPAnimEncoderGetFrameStats(enc, &num_frames);
+    FILE *const file = fopen(path, "w");
+    if (stats == nullptr || file == nullptr) {
+        fprintf(stderr, "Error! Could not write the statistics to '%s'\n",
+                path);
+        if (file != nullptr) fclose(file);
+        return false;
+    }
+    fprintf(file, "frame,timestamp,merged,reused,key_frame,candidate,"
+            "dispose,blend,x,y,width,height,bytes");
+    for (const char *kind : {"sub", "key"}) {
+        for (const char *name : kCandidateNames) {
+            fprintf(file, ",%s_%s_bytes,%s_%s_ms", kind, name, kind, name);
+        }
+    }
+    fprintf(file, "\n");
+
+    int merged = 0, reused = 0, key_frames = 0;
+    int picked[WEBP_ANIM_CANDIDATE_COUNT] = {0};
+    double time_ms = 0.;
+    for (int i = 0; i < num_frames; ++i) {
+        const WebPAnimFrameStats &s = stats[i];
+        fprintf(file, "%d,%d,%d,%d,%d,%s,%s,%s,%d,%d,%d,%d,%u", i, s.timestamp,
+                s.merged, s.reused, s.key_frame,
+                s.candidate >= 0 ? kCandidateNames[s.candidate] : "",
+                s.merged ? "" : s.dispose_method == WEBP_MUX_DISPOSE_NONE
+                                    ? "none" : "bg",
+                s.merged ? "" : s.blend_method == WEBP_MUX_BLEND
+                                    ? "blend" : "no_blend",
+                s.x_offset, s.y_offset, s.width, s.height,
+                (unsigned int) s.size);
+        for (const WebPAnimCandidateStats *c :
+             {s.sub_frame_candidates, s.key_frame_candidates}) {
+            for (int j = 0; j < WEBP_ANIM_CANDIDATE_COUNT; ++j) {
+                fprintf(file, ",%u,%.2f", (unsigned int) c[j].size,
+                        c[j].time_ms);
+                time_ms += c[j].time_ms;
+            }
+        }
+        fprintf(file, "\n");
+        merged += s.merged;
+        reused += s.reused;
+        key_frames += !s.merged && s.key_frame;
+        if (!s.merged && s.candidate >= 0) ++picked[s.candidate];
+    }
+    const bool ok = (fclose(file) == 0);
+    fprintf(stderr, "Frame stats: %d frames (%d merged, %d reused, %d key), "
+            "picked %d/%d/%d/%d (%s/%s/%s/%s), candidates %.1f ms\n",
+            num_frames, merged, reused, key_frames, picked[0], picked[1],
+            picked[2], picked[3], kCandidateNames[0], kCandidateNames[1],
+            kCandidateNames[2], kCandidateNames[3], time_ms);
+    return ok;
+}
+
 static void Help(void) {
     printf("Usage:\n");
     printf(" tgswebp [options] lottie_file -o webp_file\n");
@@ -87,15 +778,73 @@ static void Help(void) {
     printf("  -lossy ................. encode image using lossy compression\n");
     printf("  -mixed ................. for each frame in the image, pick lossy\n"
            "                           or lossless compression heuristically\n");
+    printf("  -no_predict ............ with -mixed, don't predict lossy or\n"
+           "                           lossless from the frame content\n");
+    printf("  -predict_bench ......... with -mixed, try both and report how\n"
+           "                           well the prediction does\n");
+    printf("  -no_reuse .............. encode frames that repeat an earlier\n"
+           "                           frame again instead of reusing them\n");
     printf("  -q <float> ............. quality factor (0:small..100:big)\n");
     printf("  -m <int> ............... compression method (0=fast, 6=slowest)\n");
     printf("  -s <int> ............... skip frames to reduce the output size \n");
+    printf("  -target_size <int> ..... encode under this many bytes, lowering\n"
+           "                           -q as little as needed (needs -mixed;\n"
+           "                           lossless output only shrinks with\n"
+           "                           -target_steps)\n");
+    printf("  -target_steps .......... with -target_size, also raise -s and\n"
+           "                           then lower the frame size if needed\n");
+    printf("  -sweep <string> ........ encode once more with these options\n"
+           "                           (e.g. \"-mixed -q 50\") added to the\n"
+           "                           others and report size and time; can\n"
+           "                           be repeated, runs concurrently and\n"
+           "                           writes nothing\n");
+    printf("  -store <string> ........ where rendered frames are kept for\n"
+           "                           -target_size and -sweep: memory\n"
+           "                           (default), zlib or file\n");
+    printf("  -store_delta ........... with -store zlib or file, code frames\n"
+           "                           as deltas to the previous frame\n");
+    printf("  -stats <file> .......... write per-frame encoder statistics\n"
+           "                           (candidate sizes and times, picked\n"
+           "                           candidate, key-frames) as CSV\n");
+    printf("  -bench <int> ........... render all frames this many times\n"
+           "                           without encoding and report the\n"
+           "                           per-frame min/median/p99 render time;\n"
+           "                           writes nothing\n");
+    printf("  -bench_encode .......... with -bench, render the frames once and\n"
+           "                           time encoding them instead\n");
+    printf("  -bake <int> ............ evaluate the animated properties of\n"
+           "                           all frames up front, using at most\n"
+           "                           this many MB (default: 8, 0 disables)\n");
+    printf("  -max_memory <int> ...... give up on the conversion once the\n"
+           "                           renderer and encoder hold more than\n"
+           "                           this many MB, and report the memory\n"
+           "                           held\n");
+    printf("  -max_frame_ms <float> .. give up on the conversion once a\n"
+           "                           frame takes longer to render\n");
+    printf("  -max_path_points <int> . give up once a path of a frame has\n"
+           "                           more points\n");
+    printf("  -max_repeater_copies <int>\n"
+           "                           give up on animations which repeat\n"
+           "                           shapes more often\n");
+    printf("  -max_precomp_depth <int> give up on animations which nest\n"
+           "                           precomps deeper\n");
+    printf("  -analyze ............... print the structure of the animation\n"
+           "                           and its estimated conversion cost in\n"
+           "                           ms, without converting it\n");
+    printf("  -trace <file> .......... write a trace of the rendering for\n"
+           "                           chrome://tracing or ui.perfetto.dev\n"
+           "                           (needs rlottie built with LOTTIE_TRACE)\n");
     printf("  -min_size .............. minimize output size (default:off)\n"
            "                           lossless compression by default; can be\n"
            "                           combined with -q, -m, -lossy or -mixed\n"
            "                           options\n");
+    printf("  -kmin <int> ............ min distance between key frames\n");
+    printf("  -kmax <int> ............ max distance between key frames\n"
+           "                           (default: no key frames)\n");
     printf("  -f <int> ............... filter strength (0=off..100)\n");
-    printf("  -mt .................... use multi-threading if available\n");
+    printf("  -mt .................... use multi-threading if available;\n"
+           "                           -mixed/-min_size candidates are\n"
+           "                           encoded in parallel\n");
     printf("\n");
     printf("  -version ............... print version number and exit\n");
     printf("  -frames  ............... print only original frames, test only method\n");
@@ -113,16 +862,35 @@ int main(int argc, const char *argv[]) {
     int frame_duration = 0;
     int pic_num = 0;
     int test_frames_info = 0;
+    int analyze = 0;
     int width = 512, height = 512;
     int skip = 1;
+    int target_size = 0;
+    int max_memory_mb = 0;
+    size_t max_memory = 0;
+    int bake_mb = 8;
+    size_t bake_budget = 0;
+    rlottie::RenderLimits limits;
+    bool target_steps = false;
+    FrameStore::Mode store_mode = FrameStore::kMemory;
+    bool store_delta = false;
+    std::vector<std::string> sweeps;
+    const char *trace_file = nullptr;
+    const char *stats_file = nullptr;
+    int bench_passes = 0;
+    bool bench_encode = false;
+    bool tracing = false;
+    int kmin_set = 0, kmax_set = 0;
     int total_frame_lottie = 1;
     int duration_lottie = 0;
+    size_t baked_bytes = 0;
     std::unique_ptr<rlottie::Animation> player;
     std::unique_ptr<uint32_t[]> buffer;
+    std::unique_ptr<FrameStore> store;
     WebPPicture frame;                // Frame rectangle only (not disposed).
     WebPAnimEncoder *enc = nullptr;
-    WebPAnimEncoderOptions enc_options;
-    WebPConfig config;
+    WebPAnimEncoderOptions enc_options, base_enc_options;
+    WebPConfig config, base_config;
 
     int c;
     WebPData webp_data;
@@ -147,23 +915,52 @@ int main(int argc, const char *argv[]) {
             goto End;
         } else if (!strcmp(argv[c], "-o") && c < argc - 1) {
             out_file = GET_WARGV(argv, ++c);
-        } else if (!strcmp(argv[c], "-lossy")) {
-            config.lossless = 0;
-        } else if (!strcmp(argv[c], "-mixed")) {
-            enc_options.allow_mixed = 1;
-            config.lossless = 0;
+        } else if (ParseEncoderOption(argc, argv, &c, &config, &enc_options,
+                                      &kmin_set, &kmax_set, &parse_error)) {
+            // Parsed.
         } else if (!strcmp(argv[c], "-s") && c < argc - 1) {
             skip = ExUtilGetInt(argv[++c], 0, &parse_error);
-        } else if (!strcmp(argv[c], "-q") && c < argc - 1) {
-            config.quality = ExUtilGetFloat(argv[++c], &parse_error);
-        } else if (!strcmp(argv[c], "-m") && c < argc - 1) {
-            config.method = ExUtilGetInt(argv[++c], 0, &parse_error);
-        } else if (!strcmp(argv[c], "-min_size")) {
-            enc_options.minimize_size = 1;
-        } else if (!strcmp(argv[c], "-f") && c < argc - 1) {
-            config.filter_strength = ExUtilGetInt(argv[++c], 0, &parse_error);
-        } else if (!strcmp(argv[c], "-mt")) {
-            ++config.thread_level;
+        } else if (!strcmp(argv[c], "-target_size") && c < argc - 1) {
+            target_size = ExUtilGetInt(argv[++c], 0, &parse_error);
+        } else if (!strcmp(argv[c], "-max_memory") && c < argc - 1) {
+            max_memory_mb = ExUtilGetInt(argv[++c], 0, &parse_error);
+        } else if (!strcmp(argv[c], "-bake") && c < argc - 1) {
+            bake_mb = ExUtilGetInt(argv[++c], 0, &parse_error);
+        } else if (!strcmp(argv[c], "-max_frame_ms") && c < argc - 1) {
+            limits.maxFrameMs = ExUtilGetFloat(argv[++c], &parse_error);
+        } else if (!strcmp(argv[c], "-max_path_points") && c < argc - 1) {
+            limits.maxPathPoints = ExUtilGetInt(argv[++c], 0, &parse_error);
+        } else if (!strcmp(argv[c], "-max_repeater_copies") && c < argc - 1) {
+            limits.maxRepeaterCopies = ExUtilGetInt(argv[++c], 0, &parse_error);
+        } else if (!strcmp(argv[c], "-max_precomp_depth") && c < argc - 1) {
+            limits.maxPrecompDepth = ExUtilGetInt(argv[++c], 0, &parse_error);
+        } else if (!strcmp(argv[c], "-target_steps")) {
+            target_steps = true;
+        } else if (!strcmp(argv[c], "-store") && c < argc - 1) {
+            ++c;
+            if (!strcmp(argv[c], "memory")) {
+                store_mode = FrameStore::kMemory;
+            } else if (!strcmp(argv[c], "zlib")) {
+                store_mode = FrameStore::kCompressed;
+            } else if (!strcmp(argv[c], "file")) {
+                store_mode = FrameStore::kSpillFile;
+            } else {
+                fprintf(stderr, "Error! Unknown frame store '%s'\n", argv[c]);
+                parse_error = 1;
+            }
+        } else if (!strcmp(argv[c], "-store_delta")) {
+            store_delta = true;
+        } else if (!strcmp(argv[c], "-sweep") && c < argc - 1) {
+            sweeps.push_back(argv[++c]);
+        } else if (!strcmp(argv[c], "-stats") && c < argc - 1) {
+            stats_file = argv[++c];
+            enc_options.frame_stats = 1;
+        } else if (!strcmp(argv[c], "-bench") && c < argc - 1) {
+            bench_passes = ExUtilGetInt(argv[++c], 0, &parse_error);
+        } else if (!strcmp(argv[c], "-bench_encode")) {
+            bench_encode = true;
+        } else if (!strcmp(argv[c], "-trace") && c < argc - 1) {
+            trace_file = argv[++c];
         } else if (!strcmp(argv[c], "-version")) {
             const int enc_version = WebPGetEncoderVersion();
             const int mux_version = WebPGetMuxVersion();
@@ -174,8 +971,11 @@ int main(int argc, const char *argv[]) {
             goto End;
         } else if (!strcmp(argv[c], "-frames")) {
             test_frames_info = 1;
+        } else if (!strcmp(argv[c], "-analyze")) {
+            analyze = 1;
         } else if (!strcmp(argv[c], "-v")) {
             verbose = 1;
+            enc_options.verbose = 1;
         } else if (!strcmp(argv[c], "--")) {
             if (c < argc - 1) in_file = GET_WARGV(argv, ++c);
             break;
@@ -191,11 +991,9 @@ int main(int argc, const char *argv[]) {
         if (!ok) goto End;
     }
 
-    if (!enc_options.allow_mixed) config.lossless = 1;
-    config.sns_strength = 90;
-    config.filter_sharpness = 6;
-    config.alpha_quality = 5;
-    ok = WebPValidateConfig(&config);
+    base_config = config;
+    base_enc_options = enc_options;
+    ok = FinishEncoderConfig(kmin_set, kmax_set, &config, &enc_options);
     if (!ok) {
         fprintf(stderr, "Error! Invalid configuration.\n");
         goto End;
@@ -208,6 +1006,7 @@ int main(int argc, const char *argv[]) {
         goto End;
     }
 
+    rlottie::configureRenderLimits(limits);
 
     if (tgsFile(in_file)) {
         gzFile file = gzopen(in_file, "rb");
@@ -231,6 +1030,8 @@ int main(int argc, const char *argv[]) {
         fprintf(stderr, "Error init Animation ");
         goto End;
     }
+    ok = CheckRenderError(*player, -1);
+    if (!ok) goto End;
 
 
     buffer = std::unique_ptr<uint32_t[]>(new uint32_t[width * height]);
@@ -242,6 +1043,10 @@ int main(int argc, const char *argv[]) {
         printf( "%u\n", total_frame_lottie);
         goto End;
     }
+    if (analyze) {
+        PrintComplexity(*player);
+        goto End;
+    }
 
     if (verbose) {
         fprintf(stderr, "Frames lottie:      %d\n", total_frame_lottie);
@@ -249,15 +1054,102 @@ int main(int argc, const char *argv[]) {
         fprintf(stderr, "Frame duration:     %d ms\n", frame_duration);
         fprintf(stderr, "Frames webp out:    %d\n", (total_frame_lottie / skip));
     }
+    bake_budget = (bake_mb > 0) ? (size_t) bake_mb << 20 : 0;
+    if (max_memory_mb > 0) {
+        if (!sweeps.empty() || target_size > 0 || bench_passes > 0) {
+            fprintf(stderr, "Error! -max_memory can't be combined with "
+                    "-sweep, -target_size or -bench.\n");
+            ok = 0;
+            goto End;
+        }
+        max_memory = (size_t) max_memory_mb << 20;
+        if (PeakMemory(*player, nullptr) > max_memory) {
+            fprintf(stderr, "Error! The animation needs more than %d MB.\n",
+                    max_memory_mb);
+            PrintMemory(*player, nullptr);
+            ok = 0;
+            goto End;
+        }
+        // leave most of the headroom to the rendering and the encoding.
+        bake_budget = std::min(bake_budget,
+                               (max_memory - PeakMemory(*player, nullptr)) / 4);
+    }
+
+    // every frame gets rendered, so evaluate the animated values up front
+    if (bake_budget > 0) {
+        baked_bytes = player->bake(bake_budget);
+        if (verbose) {
+            fprintf(stderr, "Baked properties:   %zu bytes\n", baked_bytes);
+        }
+    }
+
     //  player->size(reinterpret_cast<size_t &>(width), reinterpret_cast<size_t &>(height));
     frame.width = width;
     frame.height = height;
     frame.use_argb = 1;
 
+    if (trace_file != nullptr) {
+        tracing = rlottie::startTrace();
+        if (!tracing) {
+            fprintf(stderr, "Error! rlottie is built without LOTTIE_TRACE.\n");
+            ok = 0;
+            goto End;
+        }
+    }
+
+    if (stats_file != nullptr && (!sweeps.empty() || target_size > 0)) {
+        fprintf(stderr, "Error! -stats can't be combined with -sweep or "
+                "-target_size.\n");
+        ok = 0;
+        goto End;
+    }
+
+    if (bench_passes > 0 && (!sweeps.empty() || target_size > 0 ||
+                             stats_file != nullptr)) {
+        fprintf(stderr, "Error! -bench can't be combined with -sweep, "
+                "-target_size or -stats.\n");
+        ok = 0;
+        goto End;
+    }
+
+    if (bench_passes > 0 && bench_encode) {
+        store.reset(new FrameStore(store_mode, store_delta));
+        ok = RenderFrames(player.get(), width, height, skip, store.get());
+        ok = ok && BenchEncode(*store, frame_duration, bench_passes,
+                               &enc_options, &config);
+        goto End;
+    }
+
+    if (bench_passes > 0) {
+        ok = BenchRender(player.get(), width, height, skip, bench_passes);
+        goto End;
+    }
+
+    if (!sweeps.empty()) {
+        store.reset(new FrameStore(store_mode, store_delta));
+        ok = RenderFrames(player.get(), width, height, skip, store.get());
+        if (ok && verbose) PrintStoreStats(*store);
+        ok = ok && RunSweeps(*store, frame_duration, sweeps, &base_config,
+                             &base_enc_options, kmin_set, kmax_set);
+        goto End;
+    }
+
+    if (target_size > 0) {
+        store.reset(new FrameStore(store_mode, store_delta));
+        ok = EncodeToTargetSize(player.get(), store.get(), width, height, skip,
+                                (size_t) target_size, target_steps, verbose,
+                                &enc_options, &config, &webp_data, &pic_num);
+        goto Write;
+    }
+
     for (int i = 0; i < total_frame_lottie; i += skip) {
         if (verbose) fprintf(stderr, "INFO: Added frame:  %d/%d \r", i, total_frame_lottie);
         rlottie::Surface surface(buffer.get(), width, height, width * 4);
         player->renderSync(i, surface);
+        ok = CheckRenderError(*player, i);
+        if (!ok) {
+            goto End;
+        }
         ok = WebPPictureAlloc(&frame);
         if (!ok) {
             goto End;
@@ -288,6 +1180,14 @@ int main(int argc, const char *argv[]) {
             }
         }
 
+        if (ok && max_memory > 0 && PeakMemory(*player, enc) > max_memory) {
+            fprintf(stderr, "Error! More than %d MB needed at frame %d.\n",
+                    max_memory_mb, i);
+            PrintMemory(*player, enc);
+            ok = 0;
+            goto End;
+        }
+
         /*    if (verbose) {
                 WFPRINTF(stderr, "Added frame #%3d at time %4d (file: %s)\r",
                          pic_num, frame_timestamp, out_file);
@@ -305,7 +1205,15 @@ int main(int argc, const char *argv[]) {
     if (!ok) {
         fprintf(stderr, "Error during final animation assembly.\n");
     }
+    if (ok && stats_file != nullptr) ok = WriteFrameStats(enc, stats_file);
+    if (ok && max_memory > 0 && PeakMemory(*player, enc) > max_memory) {
+        fprintf(stderr, "Error! More than %d MB needed to assemble the "
+                "animation.\n", max_memory_mb);
+        ok = 0;
+    }
+    if (verbose || max_memory > 0) PrintMemory(*player, enc);
 
+    Write:
 
     if (ok && out_file != nullptr) {
         ok = ImgIoUtilWriteFile(out_file, webp_data.bytes, webp_data.size);
@@ -319,6 +1227,11 @@ int main(int argc, const char *argv[]) {
     }
     // All OK.
     End:
+    if (tracing && !rlottie::writeTrace(trace_file)) {
+        fprintf(stderr, "Error! Could not write the trace to '%s'\n",
+                trace_file);
+        ok = 0;
+    }
     WebPMuxDelete(mux);
     WebPDataClear(&webp_data);
     WebPPictureFree(&frame);